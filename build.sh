@@ -76,4 +76,9 @@ if [ -z "${NUM_KEYS}" ]; then
   fi
 fi
 
-./$BUILD_DIR/bin/benchmark_runner --benchmark_filter=BM_Sort.* --benchmark_out_format=json --benchmark_out="${BENCHMARK_FOLDER}/${BUILD_TYPE}_${COMPILER}_$ISO_TIME.json"
+# NUM_KEYS, KEY_SIZE and SORT_THREADS may be comma-separated lists to sweep. CHUNK_SIZE is fixed per process, so
+# every value in CHUNK_SIZES (space-separated) gets a run and a JSON file of its own.
+for CHUNK in ${CHUNK_SIZES:-${CHUNK_SIZE:-65535}}; do
+  CHUNK_SIZE=$CHUNK ./$BUILD_DIR/bin/benchmark_runner --benchmark_filter=BM_Sort.* --benchmark_out_format=json \
+    --benchmark_out="${BENCHMARK_FOLDER}/${BUILD_TYPE}_${COMPILER}_${ISO_TIME}_chunk${CHUNK}.json"
+done
@@ -10,4 +10,26 @@ fi
 export NUM_KEYS=10000000  # Set the number of keys to sort
 export KEY_SIZE=16    # Set the size of each key in bytes
 export N_RUNS=7       # Set the number of runs for each benchmark
-$BIN_DIR$BINARY_NAME
+# export KEY_DISTRIBUTION=zipf  # uniform (default), zipf, few_unique, sorted, reverse, nearly_sorted, shared_prefix, organ_pipe
+# export KEY_CARDINALITY=100  # Distinct keys of zipf and few_unique; alone it selects few_unique
+# export KEY_SEED=42          # Seed of the key generator
+# export ZIPF_EXPONENT=1.0    # Skew of zipf
+# export SWAP_PERCENT=1       # Keys swapped out of place in nearly_sorted
+# export SHARED_PREFIX=12     # Prefix bytes all shared_prefix keys have in common (default: all but the last 4)
+# export NUM_THREADS=8      # Size of the shared sort thread pool (default: all cores)
+# export PIN_THREADS=1      # Pin pool threads to cores
+# export MAX_SORT_THREADS=4 # Cap the threads a single sort may use
+# export SIMD_MAX_ISA=1     # SIMD kernel cap: 0 = scalar, 1 = AVX2, 2 = AVX-512
+# export EXTERNAL_SORT_MEMORY_MB=64  # also run the external sort, spilling above this much working memory
+# export TOP_K=1000         # LIMIT of the top-K benchmark
+# export SORT_LOG=1         # Log every adaptive sort decision with its sampled input statistics
+# export SORT_SAMPLE_SIZE=4096  # Keys the adaptive sort samples
+# export SORT_PERF=1         # Time every sort phase and count its cycles, instructions and cache, branch and dTLB misses
+# export KEY_FILE_LOAD=1     # Key file pages: 0 = lazy, 1 = madvise(WILLNEED), 2 = prefault (default)
+
+# ./build.sh -r -b runs the Google Benchmark BM_Sort suite instead and writes JSON to data/benchmarks/. There,
+# NUM_KEYS, KEY_SIZE and SORT_THREADS may be comma-separated lists, e.g. NUM_KEYS=1000000,10000000, and
+# CHUNK_SIZES="1024 65535" repeats the suite for each chunk size.
+
+# Pass a key file path to map its keys; a missing file is generated once and saved there
+$BIN_DIR$BINARY_NAME "$@"
@@ -11,92 +11,318 @@
 // #include <execution>
 #include <pdqsort.h>
 #include <cstring>
+#include <filesystem>
+#include <memory>
 
 #include "common.hpp"
 #include "rowid.hpp"
+#include "key_compare.hpp"
+#include "key_file.hpp"
+#include "key_encoder.hpp"
+#include "key_generator.hpp"
 #include "algorithms/radix.hpp"
 #include "algorithms/merge.hpp"
+#include "algorithms/prefix.hpp"
+#include "algorithms/samplesort.hpp"
+#include "algorithms/external_sort.hpp"
+#include "algorithms/top_k.hpp"
+#include "algorithms/var_key_sort.hpp"
+#include "algorithms/adaptive_sort.hpp"
+#include "algorithms/count_sort.hpp"
+#include "simd_isa.hpp"
 #include "utils/timer.hpp"
-
-// Wrapper for std::sort to match signature
-void std_sort_wrapper(std::vector<ByteKey> &keys)
-{
-    std::sort(keys.begin(), keys.end());
-}
+#include "utils/perf_counters.hpp"
+#include "task_scheduler.hpp"
+#include "sort_benchmarks.hpp"
 
 // void std_sort_par_wrapper(std::vector<ByteKey> &keys)
 // {
 //     std::sort(std::execution::par, keys.begin(), keys.end());
 // }
 
-std::string print_key(const ByteKey &key)
+// Baseline for top_k_wrapper: sorts everything and keeps the first TOP_K_LIMIT RowIDs
+void full_sort_top_k_wrapper(const KeyView &keys, std::vector<RowID> &row_ids)
+{
+    hybrid_radix_sort_rowids_msb(keys, row_ids);
+    row_ids.resize(std::min(row_ids.size(), TOP_K_LIMIT));
+}
+
+// Engines with equal keys ordered by RowID, to compare against their unspecified tie order
+void radix_rowid_ties_wrapper(const KeyView &keys, std::vector<RowID> &row_ids)
+{
+    hybrid_radix_sort_rowids_msb(keys, row_ids, ExecutionContext::global(), MSD_RADIX_CUTOFF, TieBreak::RowID);
+}
+
+void prefix_rowid_ties_wrapper(const KeyView &keys, std::vector<RowID> &row_ids)
+{
+    prefix_sort_rowids(keys, row_ids, ExecutionContext::global(), TieBreak::RowID);
+}
+
+void samplesort_rowid_ties_wrapper(const KeyView &keys, std::vector<RowID> &row_ids)
+{
+    samplesort_rowids(keys, row_ids, ExecutionContext::global(), TieBreak::RowID);
+}
+
+void adaptive_rowid_ties_wrapper(const KeyView &keys, std::vector<RowID> &row_ids)
+{
+    sort_rowids(keys, row_ids, ExecutionContext::global(), nullptr, TieBreak::RowID);
+}
+
+std::string print_key(const uint8_t *key, size_t key_size)
 {
     std::string result;
-    for (uint8_t byte : key)
+    for (size_t i = 0; i < key_size; ++i)
     {
-        result += static_cast<char>(byte);
+        result += static_cast<char>(key[i]);
     }
 
     return result;
 }
 
 void pdqsort_wrapper(
-    const std::vector<ByteKey> &keys,
+    const KeyView &keys,
     std::vector<RowID> &row_ids)
 {
-    const size_t KEY_SIZE = 16;
     // pdqsort(keys.begin(), keys.end());
-    pdqsort(row_ids.begin(), row_ids.end(),
-            [&](const RowID &a, const RowID &b)
-            {
-                const auto &key_a = keys[CHUNK_SIZE * a.chunk_id + a.chunk_offset];
-                const auto &key_b = keys[CHUNK_SIZE * b.chunk_id + b.chunk_offset];
-
-                //   std::cout << "Comparing keys: \n";
-                //   std::cout << "\t A (" << a.chunk_id << ", " << a.chunk_offset << "): " << print_key(key_a) << "\n";
-                //   std::cout << "\t B (" << b.chunk_id << ", " << b.chunk_offset << "): " << print_key(key_b) << "\n";
-
-                return memcmp(key_a.data(), key_b.data(), KEY_SIZE) < 0;
-                // int compare = memcmp(key_a.data(), key_b.data(), KEY_SIZE);
-                // if (compare != 0)
-                //     return compare < 0;
-            });
+    dispatch_key_size(keys.key_size(), [&](auto key_size)
+                      {
+        const KeyLess<decltype(key_size)::value> less(keys.key_size());
+        pdqsort(row_ids.begin(), row_ids.end(),
+                [&](const RowID &a, const RowID &b)
+                {
+                    const uint8_t *key_a = keys[row_index(a)];
+                    const uint8_t *key_b = keys[row_index(b)];
+
+                    //   std::cout << "Comparing keys: \n";
+                    //   std::cout << "\t A (" << a.chunk_id << ", " << a.chunk_offset << "): " << print_key(key_a) << "\n";
+                    //   std::cout << "\t B (" << b.chunk_id << ", " << b.chunk_offset << "): " << print_key(key_b) << "\n";
+
+                    return less(key_a, key_b);
+                }); });
 }
 
-void print_first_n(const std::vector<ByteKey> &keys, size_t n)
+void print_first_n(const KeyView &keys, size_t n)
 {
     std::cout << "First " << n << " keys:\n";
     for (size_t i = 0; i < n && i < keys.size(); ++i)
     {
-        std::cout << "Key " << i + 1 << ": " << print_key(keys[i]) << std::endl;
+        std::cout << "Key " << i + 1 << ": " << print_key(keys[i], keys.key_size()) << std::endl;
     }
 }
 
-void is_sorted(const std::vector<ByteKey> &keys, const std::vector<RowID> &row_ids)
+void is_sorted(const KeyView &keys, const std::vector<RowID> &row_ids)
 {
     bool sorted = std::is_sorted(row_ids.begin(), row_ids.end(),
                                  [&](const RowID &a, const RowID &b)
                                  {
-                                     const auto &key_a = keys[CHUNK_SIZE * a.chunk_id + a.chunk_offset];
-                                     const auto &key_b = keys[CHUNK_SIZE * b.chunk_id + b.chunk_offset];
-                                     return memcmp(key_a.data(), key_b.data(), key_a.size()) < 0;
+                                     return memcmp(keys[row_index(a)], keys[row_index(b)], keys.key_size()) < 0;
                                  });
     std::cout << "RowIDs are " << (sorted ? "" : "NOT ") << "sorted" << std::endl;
 }
 
-int main()
+// Throughput of the normalized-key encoder on a typical ORDER BY: a nullable integer, a float and a string column
+// whose values share a long prefix. The columns are drawn in parallel from random_word, so they only depend on seed.
+void benchmark_key_encoding(size_t num_rows, uint64_t seed, size_t n_runs)
+{
+    constexpr size_t STRING_SIZE = 20;
+    std::vector<int32_t> ints(num_rows);
+    std::vector<uint8_t> valid(num_rows);
+    std::vector<double> doubles(num_rows);
+    std::vector<char> string_data(num_rows * STRING_SIZE);
+    std::vector<std::string_view> strings(num_rows);
+    const ExecutionContext &ctx = ExecutionContext::global();
+    const size_t num_parts = num_parallel_parts(ctx, num_rows);
+    parallel_for(ctx, num_parts, [&](size_t part)
+                 {
+        const size_t end = num_rows * (part + 1) / num_parts;
+        for (size_t i = num_rows * part / num_parts; i < end; ++i)
+        {
+            const uint64_t number = random_word(seed, i, 0);
+            const uint64_t other = random_word(seed, i, 1);
+            ints[i] = static_cast<int32_t>(number);
+            doubles[i] = static_cast<int32_t>(number >> 32) / 1000.0;
+            valid[i] = other % 10 != 0;
+            char *string = string_data.data() + i * STRING_SIZE;
+            const int length = snprintf(string, STRING_SIZE, "Customer#%09d", static_cast<int>((other >> 32) % 1000000000));
+            strings[i] = std::string_view(string, static_cast<size_t>(length));
+        } });
+    const std::vector<SortColumn> columns = {
+        {ColumnType::Int32, ints.data(), valid.data(), SortOrder::Descending, NullOrder::NullsFirst},
+        {ColumnType::Float64, doubles.data()},
+        {ColumnType::String, strings.data(), nullptr, SortOrder::Ascending, NullOrder::NullsLast, 12},
+    };
+
+    KeyArena keys;
+    std::vector<long long> times;
+    for (size_t run = 0; run < n_runs; ++run)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        encode_keys(columns, num_rows, keys);
+        auto end = std::chrono::high_resolution_clock::now();
+        times.push_back(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+    }
+    const double ms = median(times) / 1000.0;
+    std::cout << "key encoding (" << columns.size() << " columns, " << keys.key_size() << "-byte keys) median: " << ms
+              << " ms (" << n_runs << " runs), " << (ms > 0 ? num_rows / ms / 1000.0 : 0.0) << " M rows/s" << std::endl;
+}
+
+// Variable-length URL keys sorted in place against the same keys padded to the longest one. The URLs are drawn in
+// parallel from random_word; only appending them to the arena is serial, as every heap offset depends on the
+// keys before it.
+void benchmark_var_keys(size_t num_keys, uint64_t seed, size_t n_runs)
 {
-    const size_t NUM_KEYS = getenv("NUM_KEYS", size_t(1e7));
-    const size_t KEY_SIZE = getenv("KEY_SIZE", size_t(16));
+    const std::string host = "https://www.example.com/";
+    std::vector<std::string> urls(num_keys);
+    const ExecutionContext &ctx = ExecutionContext::global();
+    const size_t num_parts = num_parallel_parts(ctx, num_keys);
+    parallel_for(ctx, num_parts, [&](size_t part)
+                 {
+        const size_t end = num_keys * (part + 1) / num_parts;
+        for (size_t k = num_keys * part / num_parts; k < end; ++k)
+        {
+            std::string &url = urls[k];
+            const size_t path_length = 4 + random_word(seed, k, 0) % 60;
+            url.reserve(host.size() + path_length);
+            url = host;
+            for (size_t i = 0; i < path_length; ++i)
+                url += static_cast<char>('a' + random_word(seed, k, 1 + i) % 26);
+        } });
+
+    VarKeyArena var_keys;
+    size_t max_length = 0;
+    for (const auto &url : urls)
+    {
+        max_length = std::max(max_length, url.size());
+        var_keys.push_back(url);
+    }
+    KeyArena padded(num_keys, max_length);
+    parallel_for(ctx, num_parts, [&](size_t part)
+                 {
+        const size_t end = num_keys * (part + 1) / num_parts;
+        for (size_t k = num_keys * part / num_parts; k < end; ++k)
+            std::memcpy(padded[k], urls[k].data(), urls[k].size()); });
+    std::vector<std::string>().swap(urls);
+
+    std::vector<RowID> original;
+    generate_row_ids(original, num_keys);
+    auto run = [&](const std::string &label, size_t bytes, auto &&sort)
+    {
+        std::vector<long long> times;
+        for (size_t r = 0; r < n_runs; ++r)
+        {
+            std::vector<RowID> row_ids = original;
+            auto start = std::chrono::high_resolution_clock::now();
+            sort(row_ids);
+            auto end = std::chrono::high_resolution_clock::now();
+            times.push_back(std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+        }
+        std::cout << label << " (" << bytes / (1 << 20) << " MiB of keys) median: " << median(times) << " ms (" << n_runs
+                  << " runs)" << std::endl;
+    };
+    run("varlen keys", num_keys * sizeof(VarKey) + var_keys.heap_size(), [&](std::vector<RowID> &row_ids)
+        { var_key_sort_rowids(var_keys, row_ids); });
+    run("varlen keys padded to " + std::to_string(max_length) + " bytes", num_keys * max_length,
+        [&](std::vector<RowID> &row_ids)
+        { hybrid_radix_sort_rowids_msb(padded, row_ids); });
+}
+
+// Per-worker time spent in tasks since the last call, plus the time the calling thread ran tasks itself, to make
+// load imbalance visible, and with SORT_PERF set the time and hardware counters of every sort phase per run
+void print_run_stats(const std::string &label, size_t n_runs)
+{
+    auto &scheduler = TaskScheduler::global();
+    const auto times = scheduler.busy_times();
+    scheduler.reset_busy_times();
+
+    double total = 0, max = 0;
+    std::cout << label << " busy per thread (ms):";
+    for (size_t i = 0; i < times.size(); ++i)
+    {
+        const double ms = times[i].count() / 1'000'000.0;
+        total += ms;
+        max = std::max(max, ms);
+        // The last slot is the calling thread
+        std::cout << (i + 1 == times.size() ? " | caller " : " ") << static_cast<long long>(ms);
+    }
+    const double avg = total / times.size();
+    std::cout << " | max/avg: " << (avg > 0 ? max / avg : 0.0) << std::endl;
+
+    auto &profiler = PerfProfiler::global();
+    if (profiler.enabled())
+    {
+        std::cout << label << " phases per run:" << std::endl;
+        profiler.report(std::cout, n_runs);
+        profiler.reset();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // --benchmark_* flags, as passed by build.sh -b, run the Google Benchmark suite instead of this report
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strncmp(argv[i], "--benchmark", 11) == 0)
+            return run_sort_benchmarks(argc, argv);
+    }
+
     const size_t N_RUNS = getenv("N_RUNS", size_t(7)); // Number of times to benchmark each sort
+    const size_t KEY_SEED = getenv("KEY_SEED", size_t(KeyGeneratorOptions{}.seed)); // Seed of all generated inputs
 
     auto timer = Timer();
 
     timer.lap(); // Reset timer
 
+    // With a key file argument the keys are mapped from that file, or generated once and saved there when it does
+    // not exist yet, so later runs skip key generation
+    const std::string key_file = argc > 1 ? argv[1] : "";
+    KeyArena generated;
+    std::unique_ptr<MappedKeyFile> mapped;
+    if (!key_file.empty() && std::filesystem::exists(key_file))
+    {
+        const auto load = static_cast<KeyFileLoad>(getenv("KEY_FILE_LOAD", size_t(KeyFileLoad::Prefault)));
+        mapped = std::make_unique<MappedKeyFile>(key_file, load);
+        std::cout << "Mapped " << mapped->size() << " keys of size " << mapped->key_size() << " bytes from " << key_file
+                  << " in " << timer.lap_formatted() << std::endl;
+        if (mapped->chunk_size() != CHUNK_SIZE)
+            std::cout << "Note: keys were written with chunk size " << mapped->chunk_size() << ", RowIDs use " << CHUNK_SIZE
+                      << std::endl;
+    }
+    else
+    {
+        const size_t NUM_KEYS = getenv("NUM_KEYS", size_t(1e7));
+        const size_t KEY_SIZE = getenv("KEY_SIZE", size_t(16));
+        const size_t KEY_CARDINALITY = getenv("KEY_CARDINALITY", size_t(0));
+        KeyGeneratorOptions options;
+        // A cardinality alone keeps meaning few-unique keys
+        const char *distribution = std::getenv("KEY_DISTRIBUTION");
+        if (distribution != nullptr)
+            options.distribution = parse_key_distribution(distribution);
+        else if (KEY_CARDINALITY > 0)
+            options.distribution = KeyDistribution::FewUnique;
+        options.seed = KEY_SEED;
+        options.cardinality = getenv("KEY_CARDINALITY", options.cardinality);
+        options.zipf_exponent = getenv("ZIPF_EXPONENT", options.zipf_exponent);
+        options.swap_percent = getenv("SWAP_PERCENT", options.swap_percent);
+        options.prefix_length = getenv("SHARED_PREFIX", options.prefix_length);
+        std::cout << "Generating " << NUM_KEYS << " " << key_distribution_name(options.distribution) << " keys of size "
+                  << KEY_SIZE << " bytes";
+        if (options.distribution == KeyDistribution::Zipf || options.distribution == KeyDistribution::FewUnique)
+            std::cout << " with " << options.cardinality << " distinct values";
+        std::cout << "...\n";
+        generate_keys(generated, NUM_KEYS, KEY_SIZE, options);
+        std::cout << "Key generation: " << timer.lap_formatted() << std::endl;
+        if (!key_file.empty())
+        {
+            write_key_file(key_file, generated, CHUNK_SIZE);
+            std::cout << "Saved keys to " << key_file << " in " << timer.lap_formatted() << std::endl;
+        }
+    }
+    const KeyView keys = mapped ? mapped->view() : generated.view();
+
     std::vector<RowID> row_ids;
 
-    generate_row_ids(row_ids, NUM_KEYS);
+    std::cout << "Using " << (keys.size() + CHUNK_SIZE - 1) / CHUNK_SIZE << " chunks of size " << CHUNK_SIZE << std::endl;
+    generate_row_ids(row_ids, keys.size());
     std::cout << "Generated " << row_ids.size() << " RowIDs in " << timer.lap_formatted() << std::endl;
 
     // for (const auto &row_id : row_ids)
@@ -104,10 +330,9 @@ int main()
     //     std::cout << "RowID: chunk_id=" << row_id.chunk_id << ", chunk_offset=" << row_id.chunk_offset << std::endl;
     // }
 
-    std::cout << "Generating " << NUM_KEYS << " keys of size " << KEY_SIZE << " bytes...\n";
-    std::vector<ByteKey> keys;
-    generate_keys(keys, NUM_KEYS, KEY_SIZE);
-    std::cout << "Key generation: " << timer.lap_formatted() << std::endl;
+    // Start the shared scheduler up front so thread startup is not part of the first measurement
+    std::cout << "Sorting with up to " << ExecutionContext::global().num_threads() << " threads" << std::endl;
+    std::cout << "SIMD kernels: " << simd_isa_name(simd_isa()) << std::endl;
 
     // auto sorted_keys = keys; // Copy for sorting
     // pdqsort_wrapper(sorted_keys, row_ids);
@@ -119,11 +344,60 @@ int main()
 
     // Benchmark sorts
     // benchmark_sort(keys, radix_sort, N_RUNS, "Radix sort");
-    // benchmark_sort(keys, std_sort_wrapper, N_RUNS, "std::sort");
     // benchmark_sort(keys, std_sort_par_wrapper, N_RUNS, "std::sort (parallel)");
     // benchmark_sort(keys, pdqsort_wrapper, N_RUNS, "pdqsort");
     // benchmark_sort(keys, parallel_radix_wrapper, N_RUNS, "radix (parallel)");
     // benchmark_sort(keys, row_ids, pdqsort_wrapper, N_RUNS, "pdqsort");
+    TaskScheduler::global().reset_busy_times();
+    PerfProfiler::global().reset();
     benchmark_sort(keys, row_ids, hybrid_radix_sort_rowids_msb, N_RUNS, "radix (parallel)");
+    print_run_stats("radix (parallel)", N_RUNS);
     benchmark_sort(keys, row_ids, merge_sort, N_RUNS, "merge sort");
+    print_run_stats("merge sort", N_RUNS);
+    benchmark_sort(keys, row_ids, pairwise_merge_sort_wrapper, N_RUNS, "merge sort (pairwise)");
+    print_run_stats("merge sort (pairwise)", N_RUNS);
+    benchmark_sort(keys, row_ids, bitonic_merge_sort_wrapper, N_RUNS, "merge sort (bitonic)");
+    print_run_stats("merge sort (bitonic)", N_RUNS);
+    benchmark_sort(keys, row_ids, samplesort_rowids, N_RUNS, "samplesort");
+    print_run_stats("samplesort", N_RUNS);
+    if (EXTERNAL_SORT_MEMORY_MB > 0)
+    {
+        const std::string label = "external sort (" + std::to_string(EXTERNAL_SORT_MEMORY_MB) + " MiB)";
+        benchmark_sort(keys, row_ids, external_sort_wrapper, N_RUNS, label);
+        print_run_stats(label, N_RUNS);
+    }
+    benchmark_sort(keys, row_ids, prefix_sort_wrapper, N_RUNS, "prefix sort");
+    print_run_stats("prefix sort", N_RUNS);
+    benchmark_sort(keys, row_ids, adaptive_sort_wrapper, N_RUNS, "adaptive");
+    print_run_stats("adaptive", N_RUNS);
+    {
+        auto adaptive_sorted = row_ids;
+        std::vector<size_t> groups;
+        std::cout << "adaptive decision: " << sort_rowids(keys, adaptive_sorted, ExecutionContext::global(), &groups)
+                  << std::endl;
+        std::cout << "equal-key groups: " << groups.size() - 1 << std::endl;
+        TaskScheduler::global().reset_busy_times();
+        PerfProfiler::global().reset();
+    }
+    benchmark_sort(keys, row_ids, count_sort_wrapper, N_RUNS, "count sort");
+    print_run_stats("count sort", N_RUNS);
+    benchmark_sort(keys, row_ids, radix_rowid_ties_wrapper, N_RUNS, "radix (RowID ties)");
+    print_run_stats("radix (RowID ties)", N_RUNS);
+    benchmark_sort(keys, row_ids, prefix_rowid_ties_wrapper, N_RUNS, "prefix sort (RowID ties)");
+    print_run_stats("prefix sort (RowID ties)", N_RUNS);
+    benchmark_sort(keys, row_ids, samplesort_rowid_ties_wrapper, N_RUNS, "samplesort (RowID ties)");
+    print_run_stats("samplesort (RowID ties)", N_RUNS);
+    benchmark_sort(keys, row_ids, adaptive_rowid_ties_wrapper, N_RUNS, "adaptive (RowID ties)");
+    print_run_stats("adaptive (RowID ties)", N_RUNS);
+    const std::string top_k = " (K=" + std::to_string(TOP_K_LIMIT) + ")";
+    benchmark_sort(keys, row_ids, top_k_wrapper, N_RUNS, "top-K" + top_k);
+    print_run_stats("top-K" + top_k, N_RUNS);
+    benchmark_sort(keys, row_ids, full_sort_top_k_wrapper, N_RUNS, "full sort + truncate" + top_k);
+    print_run_stats("full sort + truncate" + top_k, N_RUNS);
+
+    benchmark_key_encoding(keys.size(), KEY_SEED, N_RUNS);
+    benchmark_var_keys(keys.size(), KEY_SEED, N_RUNS);
+
+    auto prefix_sorted = row_ids;
+    std::cout << "prefix sort tie-break lookups: " << prefix_sort_rowids(keys, prefix_sorted) << std::endl;
 }
@@ -0,0 +1,93 @@
+// Task throughput of the work-stealing TaskScheduler compared to ThreadPool::enqueue
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <vector>
+
+#include "common.hpp"
+#include "thread_pool.hpp"
+#include "task_scheduler.hpp"
+
+namespace
+{
+    std::atomic<size_t> counter{0};
+
+    void tiny_task()
+    {
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Binary fork-join tree with 2^(depth + 1) - 1 tasks, spawned from inside the tasks themselves
+    void spawn_tree(TaskGroup &group, size_t depth)
+    {
+        tiny_task();
+        if (depth == 0)
+            return;
+        group.spawn([&group, depth]
+                    { spawn_tree(group, depth - 1); });
+        group.spawn([&group, depth]
+                    { spawn_tree(group, depth - 1); });
+    }
+
+    template <typename Fn>
+    void report(const std::string &label, size_t num_tasks, size_t n_runs, Fn &&run)
+    {
+        std::vector<long long> times;
+        for (size_t i = 0; i < n_runs; ++i)
+        {
+            counter = 0;
+            auto start = std::chrono::steady_clock::now();
+            run();
+            auto end = std::chrono::steady_clock::now();
+            if (counter != num_tasks)
+                std::cerr << label << ": expected " << num_tasks << " tasks, ran " << counter << "\n";
+            times.push_back(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+        }
+        const long long med = median(times);
+        const double tasks_per_second = med > 0 ? num_tasks * 1e6 / med : 0.0;
+        std::cout << label << " median: " << med << " us (" << static_cast<size_t>(tasks_per_second)
+                  << " tasks/s, " << n_runs << " runs)\n";
+    }
+}
+
+int main()
+{
+    const size_t NUM_TASKS = getenv("NUM_TASKS", size_t(1) << 20);
+    const size_t NUM_THREADS = getenv("NUM_THREADS", size_t(std::thread::hardware_concurrency()));
+    const size_t N_RUNS = getenv("N_RUNS", size_t(7));
+
+    std::cout << "Running " << NUM_TASKS << " tasks on " << NUM_THREADS << " threads\n";
+
+    {
+        ThreadPool pool(NUM_THREADS);
+        report("ThreadPool::enqueue", NUM_TASKS, N_RUNS, [&]
+               {
+            std::vector<std::future<void>> futures;
+            futures.reserve(NUM_TASKS);
+            for (size_t i = 0; i < NUM_TASKS; ++i)
+                futures.push_back(pool.enqueue(tiny_task));
+            for (auto &fut : futures)
+                fut.get(); });
+    }
+
+    {
+        TaskScheduler scheduler(NUM_THREADS);
+        report("TaskGroup::spawn (flat)", NUM_TASKS, N_RUNS, [&]
+               {
+            TaskGroup group(scheduler);
+            for (size_t i = 0; i < NUM_TASKS; ++i)
+                group.spawn(tiny_task);
+            group.sync(); });
+
+        size_t depth = 0;
+        while ((size_t(2) << (depth + 1)) - 1 <= NUM_TASKS)
+            ++depth;
+        const size_t tree_tasks = (size_t(2) << depth) - 1;
+        report("TaskGroup::spawn (nested)", tree_tasks, N_RUNS, [&]
+               {
+            TaskGroup group(scheduler);
+            spawn_tree(group, depth);
+            group.sync(); });
+    }
+}
@@ -0,0 +1,232 @@
+#include "sort_benchmarks.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include "common.hpp"
+#include "key_generator.hpp"
+#include "simd_isa.hpp"
+#include "task_scheduler.hpp"
+#include "algorithms/radix.hpp"
+#include "algorithms/merge.hpp"
+#include "algorithms/prefix.hpp"
+#include "algorithms/samplesort.hpp"
+#include "algorithms/adaptive_sort.hpp"
+#include "algorithms/count_sort.hpp"
+#include "utils/perf_counters.hpp"
+
+namespace
+{
+    struct SortAlgorithm
+    {
+        const char *name;
+        // Returns the number of threads the sort ran with
+        size_t (*sort)(const KeyView &, std::vector<RowID> &, const ExecutionContext &);
+    };
+
+    const SortAlgorithm ALGORITHMS[] = {
+        {"radix", [](const KeyView &keys, std::vector<RowID> &rowids, const ExecutionContext &ctx)
+         {
+             hybrid_radix_sort_rowids_msb(keys, rowids, ctx);
+             return ctx.num_threads();
+         }},
+        {"merge", [](const KeyView &keys, std::vector<RowID> &rowids, const ExecutionContext &ctx)
+         {
+             merge_sort(keys, rowids, ctx);
+             return ctx.num_threads();
+         }},
+        {"samplesort", [](const KeyView &keys, std::vector<RowID> &rowids, const ExecutionContext &ctx)
+         {
+             samplesort_rowids(keys, rowids, ctx);
+             return ctx.num_threads();
+         }},
+        {"prefix", [](const KeyView &keys, std::vector<RowID> &rowids, const ExecutionContext &ctx)
+         {
+             prefix_sort_rowids(keys, rowids, ctx);
+             return ctx.num_threads();
+         }},
+        {"count", [](const KeyView &keys, std::vector<RowID> &rowids, const ExecutionContext &ctx)
+         {
+             if (!count_sort_rowids(keys, rowids, ctx, COUNT_SORT_MAX_DISTINCT, nullptr))
+                 hybrid_radix_sort_rowids_msb(keys, rowids, ctx);
+             return ctx.num_threads();
+         }},
+        {"adaptive", [](const KeyView &keys, std::vector<RowID> &rowids, const ExecutionContext &ctx)
+         { return sort_rowids(keys, rowids, ctx).num_threads; }},
+    };
+
+    const KeyDistribution DISTRIBUTIONS[] = {
+        KeyDistribution::Uniform,
+        KeyDistribution::Zipf,
+        KeyDistribution::FewUnique,
+        KeyDistribution::Sorted,
+        KeyDistribution::Reverse,
+        KeyDistribution::NearlySorted,
+        KeyDistribution::SharedPrefix,
+        KeyDistribution::OrganPipe,
+    };
+
+    // Keys and RowIDs of the last benchmark. Distributions are registered outermost and thread counts innermost, so
+    // consecutive benchmarks share their input, which is generated once per distribution unless NUM_KEYS or
+    // KEY_SIZE sweep several values.
+    struct Dataset
+    {
+        size_t num_keys = 0;
+        size_t key_size = 0;
+        KeyDistribution distribution = KeyDistribution::Uniform;
+        KeyArena keys;
+        std::vector<RowID> rowids;
+    };
+
+    const Dataset &dataset(size_t num_keys, size_t key_size, KeyDistribution distribution)
+    {
+        static Dataset cached;
+        if (cached.num_keys == num_keys && cached.key_size == key_size && cached.distribution == distribution)
+            return cached;
+
+        cached.num_keys = num_keys;
+        cached.key_size = key_size;
+        cached.distribution = distribution;
+        KeyGeneratorOptions options;
+        options.distribution = distribution;
+        options.seed = getenv("KEY_SEED", size_t(options.seed));
+        generate_keys(cached.keys, num_keys, key_size, options);
+        cached.rowids.clear();
+        generate_row_ids(cached.rowids, num_keys);
+        return cached;
+    }
+
+    bool is_sorted(const KeyView &keys, const std::vector<RowID> &rowids)
+    {
+        for (size_t i = 1; i < rowids.size(); ++i)
+        {
+            if (std::memcmp(keys[row_index(rowids[i - 1])], keys[row_index(rowids[i])], keys.key_size()) > 0)
+                return false;
+        }
+        return true;
+    }
+
+    // Per-iteration time and hardware counters of every phase the profiler saw, as counters such as
+    // "leaf_sort.cycles"
+    void add_phase_counters(benchmark::State &state, PerfProfiler &profiler)
+    {
+        for (auto [phase, counters] : profiler.phases())
+        {
+            std::replace(phase.begin(), phase.end(), ' ', '_');
+            state.counters[phase + ".ms"] =
+                benchmark::Counter(counters.time.count() / 1e6, benchmark::Counter::kAvgIterations);
+            for (size_t e = 0; e < NUM_PERF_EVENTS; ++e)
+            {
+                const auto event = static_cast<PerfEvent>(e);
+                if (profiler.event_available(event))
+                    state.counters[phase + "." + perf_event_name(event)] =
+                        benchmark::Counter(counters.events[e], benchmark::Counter::kAvgIterations);
+            }
+            // Nonzero when the counts are scaled estimates
+            if (counters.multiplexed_calls > 0)
+                state.counters[phase + ".multiplexed_calls"] =
+                    benchmark::Counter(counters.multiplexed_calls, benchmark::Counter::kAvgIterations);
+        }
+    }
+
+    void BM_Sort(benchmark::State &state, const SortAlgorithm &algorithm, KeyDistribution distribution)
+    {
+        const size_t num_keys = state.range(0);
+        const size_t key_size = state.range(1);
+        const Dataset &data = dataset(num_keys, key_size, distribution);
+        const ExecutionContext ctx(TaskScheduler::global(), state.range(2));
+
+        PerfProfiler &profiler = PerfProfiler::global();
+        profiler.reset();
+        std::vector<RowID> rowids;
+        size_t threads_used = 0;
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            rowids = data.rowids;
+            state.ResumeTiming();
+            threads_used = algorithm.sort(data.keys, rowids, ctx);
+        }
+
+        if (!is_sorted(data.keys, rowids))
+            state.SkipWithError("result is not sorted");
+        state.SetItemsProcessed(state.iterations() * num_keys);
+        state.SetBytesProcessed(state.iterations() * num_keys * key_size);
+        state.counters["threads_used"] = threads_used;
+        if (profiler.enabled())
+            add_phase_counters(state, profiler);
+    }
+
+    // Comma-separated list of integers from the environment, or the default when unset or malformed
+    std::vector<int64_t> getenv_list(const char *name, std::vector<int64_t> default_value)
+    {
+        const char *value = std::getenv(name);
+        if (value == nullptr)
+            return default_value;
+        std::vector<int64_t> result;
+        try
+        {
+            for (const char *item = value; *item != '\0';)
+            {
+                size_t length;
+                result.push_back(std::stoll(item, &length));
+                item += length;
+                if (*item == ',')
+                    ++item;
+                else if (*item != '\0')
+                    return default_value;
+            }
+        }
+        catch (const std::exception &)
+        {
+            return default_value;
+        }
+        return result.empty() ? default_value : result;
+    }
+
+    // 1, 2, 4, ... threads up to all workers of the shared scheduler
+    std::vector<int64_t> default_thread_counts()
+    {
+        const int64_t available = TaskScheduler::global().num_threads();
+        std::vector<int64_t> counts;
+        for (int64_t threads = 1; threads < available; threads *= 2)
+            counts.push_back(threads);
+        counts.push_back(available);
+        return counts;
+    }
+}
+
+int run_sort_benchmarks(int argc, char **argv)
+{
+    const std::vector<std::vector<int64_t>> sweep = {
+        getenv_list("NUM_KEYS", {1 << 20}),
+        getenv_list("KEY_SIZE", {16}),
+        getenv_list("SORT_THREADS", default_thread_counts()),
+    };
+    for (KeyDistribution distribution : DISTRIBUTIONS)
+    {
+        for (const auto &algorithm : ALGORITHMS)
+        {
+            const std::string name =
+                std::string("BM_Sort/") + algorithm.name + "/" + key_distribution_name(distribution);
+            benchmark::RegisterBenchmark(name.c_str(), BM_Sort, algorithm, distribution)
+                ->ArgsProduct(sweep)
+                ->ArgNames({"keys", "key_size", "threads"})
+                ->Unit(benchmark::kMillisecond)
+                ->UseRealTime();
+        }
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::AddCustomContext("chunk_size", std::to_string(CHUNK_SIZE));
+    benchmark::AddCustomContext("simd", simd_isa_name(simd_isa()));
+    benchmark::AddCustomContext("scheduler_threads", std::to_string(TaskScheduler::global().num_threads()));
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+/**
+ * Runs the Google Benchmark BM_Sort suite: every RowID sort over every data distribution, swept over the key counts
+ * in NUM_KEYS, the key sizes in KEY_SIZE and the thread counts in SORT_THREADS (comma-separated lists). CHUNK_SIZE
+ * is fixed per process and recorded in the report context.
+ *
+ * @param argc          argument count, including the --benchmark_* flags
+ * @param argv          arguments, passed on to benchmark::Initialize
+ * @return              process exit code
+ */
+int run_sort_benchmarks(int argc, char **argv);
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+#include "rowid.hpp"
+#include "common.hpp"
+#include "task_scheduler.hpp"
+#include "algorithms/tie_break.hpp"
+
+// Keys sort_rowids samples to choose an engine (at most; small inputs sample 1/16 of their rows)
+const size_t SORT_SAMPLE_SIZE = getenv("SORT_SAMPLE_SIZE", size_t(4096));
+
+// When set, every sort_rowids call logs its decision and the sampled statistics to std::clog
+const size_t SORT_LOG = getenv("SORT_LOG", size_t(0));
+
+// Engines sort_rowids dispatches to
+enum class SortEngine
+{
+    Pdqsort,    // single-threaded pdqsort, for inputs too small to sample or parallelize
+    Presorted,  // verify the order and reverse descending input; falls back if the input is not presorted after all
+    Radix,      // hybrid_radix_sort_rowids_msb
+    Prefix,     // prefix_sort_rowids
+    Samplesort, // samplesort_rowids
+    Count,      // count_sort_rowids; falls back to the next best engine if there are more distinct keys than it takes
+};
+
+const char *sort_engine_name(SortEngine engine);
+
+/**
+ * Statistics of a sort input, estimated from up to SORT_SAMPLE_SIZE keys taken as short runs of consecutive RowIDs
+ * spread evenly over the input.
+ */
+struct InputStats
+{
+    size_t num_rows = 0;
+    size_t key_size = 0;
+    size_t sample_size = 0;
+    // Shannon entropy of the first key byte in bits, 0 (constant) to 8 (uniform)
+    double first_byte_entropy = 0;
+    // Leading bytes all sampled keys share
+    size_t common_prefix = 0;
+    // Distinct keys and distinct 8-byte key prefixes in the sample
+    size_t sample_distinct = 0;
+    size_t sample_distinct_prefixes = 0;
+    // Distinct keys in the whole input, extrapolated from the sample
+    size_t distinct_estimate = 0;
+    // Fraction of adjacent sampled pairs already in ascending (a <= b) and descending (a >= b) order
+    double ascending_fraction = 0;
+    double descending_fraction = 0;
+};
+
+// The engine and thread count sort_rowids picked, and the statistics it picked them from
+struct SortDecision
+{
+    SortEngine engine = SortEngine::Pdqsort;
+    size_t num_threads = 1;
+    InputStats stats;
+};
+
+std::ostream &operator<<(std::ostream &out, const SortDecision &decision);
+
+/**
+ * Samples keys through rowids and estimates the statistics the engine choice depends on. Costs O(sample_size)
+ * key loads plus a sort of the sample, independent of the input size.
+ */
+InputStats sample_input(
+    const KeyView &keys,
+    const std::vector<RowID> &rowids,
+    size_t sample_size = SORT_SAMPLE_SIZE);
+
+/**
+ * Picks an engine and thread count for sampled statistics:
+ *
+ * - up to 1024 rows: pdqsort on the calling thread
+ * - every sampled pair in order: Presorted, i.e. one parallel pass to verify
+ * - up to 64K rows, one thread's share: MSD radix
+ * - repeated keys in the sample and an estimated COUNT_SORT_MAX_DISTINCT distinct keys or fewer: count sort,
+ *   which hashes every key once and sorts only the distinct ones
+ * - at most 1/8 distinct keys in the sample: samplesort, whose equality buckets finish duplicates early
+ * - no common prefix, a first byte with at least 4 but less than 7 bits of entropy and 8-byte prefixes that leave
+ *   (almost) no ties: prefix sort, which fans out over the well spread first byte and then needs almost no
+ *   full-key tie-breaks
+ * - otherwise: MSD radix, which skips constant bytes and splits oversized buckets on their next byte
+ *
+ * Threads are capped at one per 64K rows, so small inputs do not pay for task fan-out.
+ */
+SortDecision choose_sort(const InputStats &stats, const ExecutionContext &ctx);
+
+/**
+ * Adaptive RowID sort: samples the input, chooses an engine with choose_sort and runs it.
+ *
+ * @param keys          flat array of keys (index = chunk_id * CHUNKSIZE + chunk_offset)
+ * @param rowids        vector of RowID to sort in-place
+ * @param ctx           scheduler and thread cap to run with
+ * @param group_starts  if set, receives the start of every group of equal keys in the result, followed by n. The
+ *                      count sort produces them as a by-product, other engines need one find_key_groups pass.
+ * @param tie_break     order of RowIDs with equal keys
+ * @return              the engine that sorted the input, its thread count and the sampled statistics
+ */
+SortDecision sort_rowids(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    std::vector<size_t> *group_starts = nullptr,
+    TieBreak tie_break = TieBreak::Unspecified);
+
+inline SortDecision sort_rowids(
+    const KeyView &keys,
+    std::vector<RowID> &rowids)
+{
+    return sort_rowids(keys, rowids, ExecutionContext::global());
+}
+
+inline void adaptive_sort_wrapper(const KeyView &keys, std::vector<RowID> &rowids)
+{
+    sort_rowids(keys, rowids);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Merges two runs of {64-bit key prefix, 32-bit index} pairs that are sorted by prefix.
+ *
+ * The SIMD kernels keep one register of the largest elements seen so far and merge it with the next register of
+ * whichever run has the smaller head through a bitonic merge network, so the only data-dependent branch is
+ * taken once per 4 (AVX2) or 8 (AVX-512) outputs. The scalar fallback selects with conditional moves. The
+ * kernel is picked at runtime from the CPU features (see simd_isa.hpp). Equal prefixes end up in unspecified
+ * order.
+ *
+ * @param a_prefixes    prefixes of the first run
+ * @param a_indices     indices of the first run
+ * @param na            length of the first run
+ * @param b_prefixes    prefixes of the second run
+ * @param b_indices     indices of the second run
+ * @param nb            length of the second run
+ * @param out_prefixes  na + nb merged prefixes; must not overlap the inputs
+ * @param out_indices   na + nb merged indices; must not overlap the inputs
+ */
+void bitonic_merge(
+    const uint64_t *a_prefixes, const uint32_t *a_indices, size_t na,
+    const uint64_t *b_prefixes, const uint32_t *b_indices, size_t nb,
+    uint64_t *out_prefixes, uint32_t *out_indices);
+
+// The individual kernels; the SIMD ones may only be called when the CPU supports them. The scalar fallback is a
+// plain two-way merge that selects with conditional moves rather than a bitonic network.
+void merge_scalar(
+    const uint64_t *a_prefixes, const uint32_t *a_indices, size_t na,
+    const uint64_t *b_prefixes, const uint32_t *b_indices, size_t nb,
+    uint64_t *out_prefixes, uint32_t *out_indices);
+void bitonic_merge_avx2(
+    const uint64_t *a_prefixes, const uint32_t *a_indices, size_t na,
+    const uint64_t *b_prefixes, const uint32_t *b_indices, size_t nb,
+    uint64_t *out_prefixes, uint32_t *out_indices);
+void bitonic_merge_avx512(
+    const uint64_t *a_prefixes, const uint32_t *a_indices, size_t na,
+    const uint64_t *b_prefixes, const uint32_t *b_indices, size_t nb,
+    uint64_t *out_prefixes, uint32_t *out_indices);
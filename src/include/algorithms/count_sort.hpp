@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "rowid.hpp"
+#include "common.hpp"
+#include "task_scheduler.hpp"
+#include "algorithms/radix.hpp"
+#include "algorithms/tie_break.hpp"
+
+// Most distinct keys count_sort_rowids handles before it gives up
+const size_t COUNT_SORT_MAX_DISTINCT = getenv("COUNT_SORT_MAX_DISTINCT", size_t(1 << 17));
+
+/**
+ * Count-first sort for low-cardinality keys, e.g. status codes or dates.
+ *
+ * Every thread hashes the keys of its share of the RowIDs into a small table of distinct keys with their counts,
+ * remembering each RowID's table slot. Only the distinct keys are sorted; a prefix sum over (key, thread) then
+ * gives every thread disjoint output slots per key, and the RowIDs are scattered straight into their groups. The
+ * cost is O(n + d log d) for d distinct keys, no key is compared twice with an equal one, and the result is
+ * stable.
+ *
+ * @param keys          flat array of keys (index = chunk_id * CHUNKSIZE + chunk_offset)
+ * @param rowids        vector of RowID to sort in-place; left unchanged when the sort gives up
+ * @param ctx           scheduler and thread cap to run with
+ * @param max_distinct  number of distinct keys above which the sort gives up
+ * @param group_starts  if set, receives the start of every group of equal keys in the result, followed by n
+ * @param tie_break     order of RowIDs with equal keys
+ * @return              false if there were more than max_distinct distinct keys
+ */
+bool count_sort_rowids(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    size_t max_distinct = COUNT_SORT_MAX_DISTINCT,
+    std::vector<size_t> *group_starts = nullptr,
+    TieBreak tie_break = TieBreak::Unspecified);
+
+/**
+ * Finds the groups of equal keys in sorted RowIDs with one parallel pass over adjacent pairs.
+ *
+ * @return              start of every group, followed by rowids.size()
+ */
+std::vector<size_t> find_key_groups(
+    const KeyView &keys,
+    const std::vector<RowID> &rowids,
+    const ExecutionContext &ctx);
+
+// Count sort that falls back to the radix sort when there are too many distinct keys
+inline void count_sort_wrapper(const KeyView &keys, std::vector<RowID> &rowids)
+{
+    if (!count_sort_rowids(keys, rowids, ExecutionContext::global()))
+        hybrid_radix_sort_rowids_msb(keys, rowids);
+}
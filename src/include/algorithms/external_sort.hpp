@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include "rowid.hpp"
+#include "common.hpp"
+#include "task_scheduler.hpp"
+#include "algorithms/tie_break.hpp"
+
+// Working memory of external_sort_rowids in MiB when no limit is passed; 0 means unlimited
+const size_t EXTERNAL_SORT_MEMORY_MB = getenv("EXTERNAL_SORT_MEMORY_MB", size_t(0));
+
+// In-memory sort external_sort_rowids runs on every batch
+enum class RunSortEngine
+{
+    // hybrid_radix_sort_rowids_msb; needs 17 bytes per RowID of the batch
+    Radix,
+    // merge_sort with the k-way strategy; needs 16 bytes per RowID of the batch
+    Merge,
+};
+
+/**
+ * Out-of-core RowID sort with a bound on its working memory.
+ *
+ * When the batch buffers of the chosen engine fit into memory_limit, the RowIDs are simply sorted in memory.
+ * Otherwise the input is cut into batches that fit, chunk-aligned when at least one chunk does, every batch is
+ * sorted by the engine and written to its own temporary file as a run of {8-byte key prefix, RowID} records, and
+ * the runs are merged k-way back into rowids. The merge reads every run through a buffer of equal size, issues read-ahead for the
+ * next stretch of the file after each refill, and merges whatever is safe to emit from all buffers in parallel.
+ *
+ * Temporary files are created in $TMPDIR (or /tmp) and unlinked right away, so they never outlive the sort.
+ * I/O errors are thrown as std::system_error.
+ *
+ * @param keys          flat array of keys (index = chunk_id * CHUNKSIZE + chunk_offset); must stay in memory
+ * @param rowids        vector of RowID to sort in-place; not counted against the limit
+ * @param ctx           scheduler and thread cap to run with
+ * @param memory_limit  bytes of working memory the sort may allocate; 0 means unlimited. Batches, the spill
+ *                      buffer and every merge buffer get at least 1024 records, so limits below about 40 KiB, or
+ *                      with many runs, can be exceeded.
+ * @param engine        in-memory sort for the batches
+ * @param tie_break     order of RowIDs with equal keys
+ * @return              number of runs spilled to disk, 0 when the input was sorted in memory
+ */
+size_t external_sort_rowids(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    size_t memory_limit,
+    RunSortEngine engine = RunSortEngine::Radix,
+    TieBreak tie_break = TieBreak::Unspecified);
+
+inline void external_sort_wrapper(const KeyView &keys, std::vector<RowID> &rowids)
+{
+    external_sort_rowids(keys, rowids, ExecutionContext::global(), EXTERNAL_SORT_MEMORY_MB << 20);
+}
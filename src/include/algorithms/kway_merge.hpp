@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "task_scheduler.hpp"
+#include "utils/perf_counters.hpp"
+
+// A sorted input run [first, last)
+template <typename T>
+struct MergeRun
+{
+    const T *first;
+    const T *last;
+
+    size_t size() const { return static_cast<size_t>(last - first); }
+};
+
+/**
+ * Tournament tree of losers over k sorted runs. Each internal node keeps the loser of the match played there and
+ * the overall winner sits at the root, so producing the next output costs one replay of log2(k) matches along a
+ * single leaf-to-root path. Ties go to the run with the lower index, which keeps the merge stable.
+ */
+template <typename T, typename Compare>
+class LoserTree
+{
+public:
+    LoserTree(const std::vector<MergeRun<T>> &runs, Compare cmp)
+        : _runs(runs), _cmp(cmp)
+    {
+        _leaves = 1;
+        while (_leaves < _runs.size())
+            _leaves *= 2;
+        _runs.resize(_leaves, MergeRun<T>{nullptr, nullptr});
+        _tree.resize(_leaves);
+        _tree[0] = build(1);
+    }
+
+    // Writes the next count outputs to out
+    void merge(T *out, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t winner = _tree[0];
+            out[i] = *_runs[winner].first++;
+            for (size_t node = (winner + _leaves) / 2; node > 0; node /= 2)
+            {
+                if (beats(_tree[node], winner))
+                    std::swap(_tree[node], winner);
+            }
+            _tree[0] = winner;
+        }
+    }
+
+private:
+    // Whether the head of run a comes before the head of run b; exhausted runs lose every match
+    bool beats(size_t a, size_t b) const
+    {
+        const MergeRun<T> &x = _runs[a];
+        const MergeRun<T> &y = _runs[b];
+        if (x.first == x.last)
+            return false;
+        if (y.first == y.last)
+            return true;
+        if (_cmp(*x.first, *y.first))
+            return true;
+        if (_cmp(*y.first, *x.first))
+            return false;
+        return a < b;
+    }
+
+    // Plays the matches below node, stores their losers and returns the winner
+    size_t build(size_t node)
+    {
+        if (node >= _leaves)
+            return node - _leaves;
+        const size_t left = build(2 * node);
+        const size_t right = build(2 * node + 1);
+        if (beats(left, right))
+        {
+            _tree[node] = right;
+            return left;
+        }
+        _tree[node] = left;
+        return right;
+    }
+
+    std::vector<MergeRun<T>> _runs;
+    std::vector<size_t> _tree;
+    size_t _leaves;
+    Compare _cmp;
+};
+
+/**
+ * Multi-sequence selection: splits k sorted runs at positions whose sum is rank, such that every element left of
+ * the split precedes every element right of it in the stable merge order (ties ordered by run index).
+ *
+ * @return              split position within every run
+ */
+template <typename T, typename Compare>
+std::vector<size_t> multiway_split(const std::vector<MergeRun<T>> &runs, size_t rank, Compare cmp)
+{
+    const size_t k = runs.size();
+    std::vector<size_t> lo(k, 0), hi(k), count(k);
+    size_t lo_sum = 0;
+    for (size_t i = 0; i < k; ++i)
+        hi[i] = runs[i].size();
+
+    while (lo_sum < rank)
+    {
+        // Pivot: middle of the widest remaining interval
+        size_t pivot_run = 0;
+        for (size_t i = 1; i < k; ++i)
+            if (hi[i] - lo[i] > hi[pivot_run] - lo[pivot_run])
+                pivot_run = i;
+        const size_t pivot_pos = lo[pivot_run] + (hi[pivot_run] - lo[pivot_run]) / 2;
+        const T &pivot = runs[pivot_run].first[pivot_pos];
+
+        // Rank of the pivot: equal elements of earlier runs precede it, those of later runs follow it
+        size_t pivot_rank = 0;
+        for (size_t i = 0; i < k; ++i)
+        {
+            const T *first = runs[i].first + lo[i];
+            const T *last = runs[i].first + hi[i];
+            if (i == pivot_run)
+                count[i] = pivot_pos;
+            else if (i < pivot_run)
+                count[i] = std::upper_bound(first, last, pivot, cmp) - runs[i].first;
+            else
+                count[i] = std::lower_bound(first, last, pivot, cmp) - runs[i].first;
+            pivot_rank += count[i];
+        }
+
+        if (pivot_rank == rank)
+            return count;
+        if (pivot_rank < rank)
+        {
+            // The pivot and everything before it are left of the split
+            lo = count;
+            lo[pivot_run] = pivot_pos + 1;
+        }
+        else
+        {
+            hi = count;
+        }
+        lo_sum = 0;
+        for (size_t i = 0; i < k; ++i)
+            lo_sum += lo[i];
+    }
+    return lo;
+}
+
+/**
+ * Stable k-way merge of runs into out in a single pass. The output is cut into ctx.num_threads() equal ranges by
+ * multi-sequence selection and every range is merged by its own loser tree.
+ */
+template <typename T, typename Compare>
+void parallel_kway_merge(const ExecutionContext &ctx, const std::vector<MergeRun<T>> &runs, T *out, Compare cmp)
+{
+    size_t total = 0;
+    for (const auto &run : runs)
+        total += run.size();
+    if (total == 0)
+        return;
+
+    const size_t parts = std::max<size_t>(1, std::min(ctx.num_threads(), total));
+    std::vector<std::vector<size_t>> splits(parts + 1);
+    splits[0].assign(runs.size(), 0);
+    splits[parts].resize(runs.size());
+    for (size_t i = 0; i < runs.size(); ++i)
+        splits[parts][i] = runs[i].size();
+    parallel_for(ctx, parts - 1, [&](size_t p)
+                 { splits[p + 1] = multiway_split(runs, (p + 1) * total / parts, cmp); });
+
+    parallel_for(ctx, parts, [&](size_t p)
+                 {
+        const PerfPhase phase("merge");
+        std::vector<MergeRun<T>> part_runs(runs.size());
+        for (size_t i = 0; i < runs.size(); ++i)
+            part_runs[i] = {runs[i].first + splits[p][i], runs[i].first + splits[p + 1][i]};
+        LoserTree<T, Compare> tree(part_runs, cmp);
+        tree.merge(out + p * total / parts, (p + 1) * total / parts - p * total / parts); });
+}
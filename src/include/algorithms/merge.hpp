@@ -4,7 +4,54 @@
 
 #include "rowid.hpp"
 #include "common.hpp"
+#include "task_scheduler.hpp"
+#include "algorithms/tie_break.hpp"
 
+// How merge_sort combines its sorted chunks
+enum class MergeStrategy
+{
+    // log2(P) rounds of pairwise merges, each round split across all threads by merge path
+    Pairwise,
+    // One pass over all P chunks through loser trees, split across all threads by multi-sequence selection
+    KWay,
+    // Pairwise rounds over {8-byte prefix, 32-bit position} pairs with the SIMD bitonic merge kernel, followed by
+    // a full-key pass over runs of equal prefixes. Needs 24 bytes per RowID on top of the two RowID buffers.
+    Bitonic,
+};
+
+/**
+ * Sorts one chunk per thread with pdqsort and merges the sorted chunks.
+ *
+ * @param keys          flat array of keys (index = chunk_id * CHUNKSIZE + chunk_offset)
+ * @param rowids        vector of RowID to sort in-place
+ * @param ctx           scheduler and thread cap to run with
+ * @param strategy      how the sorted chunks are merged
+ * @param scratch       optional caller-owned buffer, resized to rowids.size(); without one a buffer is allocated
+ *                      per call. The sort ping-pongs between rowids and scratch and swaps them if the result ends up
+ *                      in scratch, so the two vectors may trade storage.
+ * @param tie_break     order of RowIDs with equal keys
+ */
 void merge_sort(
-    const std::vector<ByteKey> &keys,
-    std::vector<RowID> &rowids);
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    MergeStrategy strategy = MergeStrategy::KWay,
+    std::vector<RowID> *scratch = nullptr,
+    TieBreak tie_break = TieBreak::Unspecified);
+
+inline void merge_sort(
+    const KeyView &keys,
+    std::vector<RowID> &rowids)
+{
+    merge_sort(keys, rowids, ExecutionContext::global());
+}
+
+inline void pairwise_merge_sort_wrapper(const KeyView &keys, std::vector<RowID> &rowids)
+{
+    merge_sort(keys, rowids, ExecutionContext::global(), MergeStrategy::Pairwise);
+}
+
+inline void bitonic_merge_sort_wrapper(const KeyView &keys, std::vector<RowID> &rowids)
+{
+    merge_sort(keys, rowids, ExecutionContext::global(), MergeStrategy::Bitonic);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+
+/**
+ * Merge path (co-ranking): returns how many elements of a are among the first `diagonal` outputs of the stable
+ * merge of a and b (ties taken from a first, as std::merge does). The remaining diagonal - i outputs come from b.
+ */
+template <typename T, typename Compare>
+size_t merge_path_corank(size_t diagonal, const T *a, size_t na, const T *b, size_t nb, Compare cmp)
+{
+    size_t lo = diagonal > nb ? diagonal - nb : 0;
+    size_t hi = std::min(diagonal, na);
+    while (lo < hi)
+    {
+        const size_t i = lo + (hi - lo) / 2;
+        // a[i] precedes b[diagonal - i - 1] in the merge, so it is within the first `diagonal` outputs
+        if (!cmp(b[diagonal - i - 1], a[i]))
+            lo = i + 1;
+        else
+            hi = i;
+    }
+    return lo;
+}
+
+/**
+ * Writes outputs [begin, end) of the stable merge of a and b to out + begin. Disjoint output ranges can be
+ * produced independently, which splits one merge into equally sized parallel pieces.
+ */
+template <typename T, typename Compare>
+void merge_path_range(const T *a, size_t na, const T *b, size_t nb, T *out, size_t begin, size_t end, Compare cmp)
+{
+    const size_t a_begin = merge_path_corank(begin, a, na, b, nb, cmp);
+    const size_t a_end = merge_path_corank(end, a, na, b, nb, cmp);
+    std::merge(a + a_begin, a + a_end, b + (begin - a_begin), b + (end - a_end), out + begin, cmp);
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+#include "task_scheduler.hpp"
+#include "algorithms/partition.hpp"
+
+// Depth of a leaf whose records are all equal and need no sorting
+constexpr size_t LEAF_SORTED = SIZE_MAX;
+
+// A range of an MSD sort that is small enough to be sorted by one task
+struct LeafBucket
+{
+    size_t begin;
+    size_t size;
+    size_t depth; // first digit position that may still differ, or LEAF_SORTED
+    int buffer;   // index into the ping-pong buffer pair that currently holds the range
+};
+
+/**
+ * Splits oversized ranges on their next digit position using all threads, so that a dominant digit (or a common
+ * prefix such as "http") does not end up as one serial task. Every split moves a range to the other buffer of the
+ * pair. Ranges of at most max_leaf records, and ranges with all max_depth digit positions consumed, become leaves.
+ *
+ * @tparam NumBuckets   digits per position, 256 for one key byte
+ * @tparam EndBucket    digit 0 means the key has ended: those records are equal and become a LEAF_SORTED leaf
+ * @param buffers       ping-pong buffer pair of the same size; buffers[buffer] holds [begin, begin + size)
+ * @param digit_of      DigitOf<NumBuckets>(const T &record, size_t depth): digit of a record at a position
+ * @param leaves        receives the leaves in order
+ */
+template <size_t NumBuckets, bool EndBucket = false, typename T, typename DigitFn>
+void split_oversized(
+    const ExecutionContext &ctx,
+    T *const buffers[2],
+    size_t begin,
+    size_t size,
+    size_t depth,
+    int buffer,
+    size_t max_leaf,
+    size_t max_depth,
+    const DigitFn &digit_of,
+    std::vector<LeafBucket> &leaves)
+{
+    if (size <= max_leaf || depth >= max_depth)
+    {
+        leaves.push_back({begin, size, depth, buffer});
+        return;
+    }
+    const BucketBoundsOf<NumBuckets> bounds = parallel_partition<NumBuckets>(
+        buffers[buffer] + begin, buffers[1 - buffer] + begin, size,
+        [&](const T &record)
+        { return digit_of(record, depth); },
+        &ctx, ctx.num_threads());
+    for (size_t b = 0; b < NumBuckets; ++b)
+    {
+        const size_t bucket_size = bounds[b + 1] - bounds[b];
+        if (bucket_size == 0)
+            continue;
+        if (EndBucket && b == 0)
+            leaves.push_back({begin, bucket_size, LEAF_SORTED, 1 - buffer});
+        else
+            split_oversized<NumBuckets, EndBucket>(ctx, buffers, begin + bounds[b], bucket_size, depth + 1,
+                                                   1 - buffer, max_leaf, max_depth, digit_of, leaves);
+    }
+}
+
+// The buffer of the pair that holds most records of the leaves, so the fewest have to be copied to the other
+inline int result_buffer(const std::vector<LeafBucket> &leaves, size_t n)
+{
+    size_t in_second = 0;
+    for (const auto &leaf : leaves)
+        in_second += leaf.buffer == 1 ? leaf.size : 0;
+    return in_second * 2 > n ? 1 : 0;
+}
+
+/**
+ * Sorts the leaves largest-first: one runner per thread grabs the largest leaf not taken yet, so a few big leaves
+ * do not end up behind many small ones on the same thread. Leaves are reordered by size.
+ *
+ * @param runners       group the runners are spawned into; sort_leaf may spawn sub-tasks into it, which then
+ *                      share the sort's thread cap and can be stolen by idle workers
+ * @param sort_leaf     void(const LeafBucket &leaf, T *data, T *other): sorts data[0, leaf.size), the range of the
+ *                      leaf in buffers[leaf.buffer], with other as the same range of the other buffer for scratch
+ */
+template <typename T, typename SortLeaf>
+void sort_leaves(
+    const ExecutionContext &ctx,
+    TaskGroup &runners,
+    T *const buffers[2],
+    std::vector<LeafBucket> &leaves,
+    const SortLeaf &sort_leaf)
+{
+    std::sort(leaves.begin(), leaves.end(), [](const LeafBucket &a, const LeafBucket &b)
+              { return a.size > b.size; });
+    std::atomic<size_t> next_leaf{0};
+    const size_t num_runners = std::min(ctx.num_threads(), leaves.size());
+    for (size_t t = 0; t < num_runners; ++t)
+    {
+        runners.spawn([&]
+                      {
+            for (size_t i; (i = next_leaf.fetch_add(1)) < leaves.size();)
+            {
+                const LeafBucket &leaf = leaves[i];
+                sort_leaf(leaf, buffers[leaf.buffer] + leaf.begin, buffers[1 - leaf.buffer] + leaf.begin);
+            } });
+    }
+    runners.sync();
+}
+
+/**
+ * Copies every leaf that is not in buffers[target] over, in parallel. Only call this once sub-tasks spawned by
+ * sort_leaf have finished, as they may run on other workers than the runner of their leaf.
+ */
+template <typename T>
+void gather_leaves(
+    const ExecutionContext &ctx,
+    T *const buffers[2],
+    const std::vector<LeafBucket> &leaves,
+    int target)
+{
+    const size_t num_parts = std::min(ctx.num_threads(), leaves.size());
+    parallel_for(ctx, num_parts, [&](size_t t)
+                 {
+        for (size_t i = t; i < leaves.size(); i += num_parts)
+        {
+            const LeafBucket &leaf = leaves[i];
+            if (leaf.buffer != target)
+                std::copy(buffers[leaf.buffer] + leaf.begin, buffers[leaf.buffer] + leaf.begin + leaf.size,
+                          buffers[target] + leaf.begin);
+        } });
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include "task_scheduler.hpp"
+#include "utils/perf_counters.hpp"
+
+constexpr size_t RADIX = 256; // byte = 0–255
+
+// Bucket b of a partition into NumBuckets buckets occupies out[bounds[b], bounds[b + 1])
+template <size_t NumBuckets>
+using BucketBoundsOf = std::array<size_t, NumBuckets + 1>;
+using PartitionBounds = BucketBoundsOf<RADIX>;
+
+// Smallest type that holds a digit of a partition into NumBuckets buckets
+template <size_t NumBuckets>
+using DigitOf = std::conditional_t<(NumBuckets <= 256), uint8_t, uint16_t>;
+
+namespace partition_detail
+{
+    // Bytes staged per bucket before they are written to the output in one go
+    constexpr size_t WC_BYTES = 256;
+
+    // Inputs smaller than this are partitioned by the calling thread
+    constexpr size_t MIN_BLOCK_SIZE = 1 << 14;
+
+    template <size_t Stride>
+    inline void copy_record(uint8_t *dst, const uint8_t *src, size_t stride)
+    {
+        std::memcpy(dst, src, Stride ? Stride : stride);
+    }
+}
+
+/**
+ * Scatters records [begin, end) of in to out, given their cached digits and the first output slot of every
+ * bucket. Records are staged in a small per-bucket buffer (software write-combining) and flushed a few cache
+ * lines at a time, so the scatter does not touch 256 random output lines per record.
+ *
+ * @tparam Stride       record size in bytes, or 0 to use the runtime stride
+ * @tparam NumBuckets   number of buckets (digits), 256 for one key byte
+ * @param offsets       next output slot per bucket (in records), updated in-place
+ */
+template <size_t Stride = 0, size_t NumBuckets = RADIX>
+void scatter_by_digits(
+    const uint8_t *in,
+    uint8_t *out,
+    const DigitOf<NumBuckets> *digits,
+    size_t begin,
+    size_t end,
+    size_t stride,
+    std::array<size_t, NumBuckets> &offsets)
+{
+    using partition_detail::copy_record;
+    const size_t s = Stride ? Stride : stride;
+    const size_t buffered = partition_detail::WC_BYTES / s;
+
+    // Staging only pays off once most buffers fill up at least once
+    if (buffered <= 1 || end - begin < NumBuckets * buffered)
+    {
+        for (size_t i = begin; i < end; ++i)
+            copy_record<Stride>(out + offsets[digits[i]]++ * s, in + i * s, s);
+        return;
+    }
+
+    std::vector<uint8_t> buffer(NumBuckets * buffered * s);
+    std::array<uint16_t, NumBuckets> fill = {};
+    for (size_t i = begin; i < end; ++i)
+    {
+        const size_t b = digits[i];
+        uint8_t *slot = buffer.data() + (b * buffered + fill[b]) * s;
+        copy_record<Stride>(slot, in + i * s, s);
+        if (++fill[b] == buffered)
+        {
+            std::memcpy(out + offsets[b] * s, buffer.data() + b * buffered * s, buffered * s);
+            offsets[b] += buffered;
+            fill[b] = 0;
+        }
+    }
+    for (size_t b = 0; b < NumBuckets; ++b)
+    {
+        std::memcpy(out + offsets[b] * s, buffer.data() + b * buffered * s, fill[b] * s);
+        offsets[b] += fill[b];
+    }
+}
+
+/**
+ * Count-then-scatter partitioning of n fixed-size records into 256 buckets (or NumBuckets).
+ *
+ * The input is split into blocks. Every block builds its own histogram (caching the digits), a prefix sum over
+ * (bucket, block) gives each block disjoint output offsets, and the blocks then scatter in parallel into the
+ * preallocated output. The partition is stable.
+ *
+ * @tparam Stride       record size in bytes, or 0 to use the runtime stride
+ * @tparam NumBuckets   number of buckets, 256 for one key byte
+ * @param digit_of      DigitOf<NumBuckets>(size_t i): digit of the i-th input record
+ * @param ctx           execution context for the block tasks, or nullptr to run on the calling thread
+ * @param num_blocks    maximum number of blocks to split the input into
+ */
+template <size_t Stride = 0, size_t NumBuckets = RADIX, typename DigitFn>
+BucketBoundsOf<NumBuckets> partition_records(
+    const uint8_t *in,
+    uint8_t *out,
+    size_t n,
+    size_t stride,
+    DigitFn digit_of,
+    const ExecutionContext *ctx = nullptr,
+    size_t num_blocks = 1)
+{
+    BucketBoundsOf<NumBuckets> bounds = {};
+    if (n == 0)
+        return bounds;
+
+    if (ctx == nullptr)
+        num_blocks = 1;
+    num_blocks = std::max<size_t>(1, std::min(num_blocks, n / partition_detail::MIN_BLOCK_SIZE));
+    const size_t block_size = (n + num_blocks - 1) / num_blocks;
+
+    std::vector<DigitOf<NumBuckets>> digits(n);
+    std::vector<std::array<size_t, NumBuckets>> offsets(num_blocks);
+
+    auto run_blocks = [&](auto &&fn)
+    {
+        if (ctx == nullptr || num_blocks == 1)
+            fn(size_t{0});
+        else
+            parallel_for(*ctx, num_blocks, fn);
+    };
+
+    // 1) Per-block histograms
+    run_blocks([&](size_t block)
+               {
+        const PerfPhase phase("histogram");
+        auto &count = offsets[block];
+        count = {};
+        const size_t end = std::min(n, (block + 1) * block_size);
+        for (size_t i = block * block_size; i < end; ++i)
+        {
+            const DigitOf<NumBuckets> b = digit_of(i);
+            digits[i] = b;
+            count[b]++;
+        } });
+
+    // 2) Prefix sum in (bucket, block) order turns the counts into disjoint output offsets
+    size_t sum = 0;
+    for (size_t b = 0; b < NumBuckets; ++b)
+    {
+        bounds[b] = sum;
+        for (auto &block_offsets : offsets)
+        {
+            const size_t count = block_offsets[b];
+            block_offsets[b] = sum;
+            sum += count;
+        }
+    }
+    bounds[NumBuckets] = sum;
+
+    // 3) Scatter every block into its own slots
+    run_blocks([&](size_t block)
+               {
+        const PerfPhase phase("scatter");
+        const size_t end = std::min(n, (block + 1) * block_size);
+        scatter_by_digits<Stride, NumBuckets>(in, out, digits.data(), block * block_size, end, stride, offsets[block]); });
+
+    return bounds;
+}
+
+/**
+ * Typed front end of partition_records.
+ *
+ * @param digit_of      DigitOf<NumBuckets>(const T &): digit of a record
+ */
+template <size_t NumBuckets = RADIX, typename T, typename DigitFn>
+BucketBoundsOf<NumBuckets> parallel_partition(
+    const T *in,
+    T *out,
+    size_t n,
+    DigitFn digit_of,
+    const ExecutionContext *ctx = nullptr,
+    size_t num_blocks = 1)
+{
+    return partition_records<sizeof(T), NumBuckets>(
+        reinterpret_cast<const uint8_t *>(in), reinterpret_cast<uint8_t *>(out), n, sizeof(T),
+        [&](size_t i)
+        { return digit_of(in[i]); },
+        ctx, num_blocks);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "rowid.hpp"
+#include "common.hpp"
+#include "task_scheduler.hpp"
+#include "algorithms/tie_break.hpp"
+
+/**
+ * Prefix-cached RowID sort.
+ *
+ * Builds a dense array of {big-endian 8-byte key prefix, RowID} records, sorts it by integer comparison and
+ * only loads the full keys to break ties within runs of equal prefixes. The records are partitioned on the first
+ * prefix byte, and buckets of more than one thread's share on the following ones, before every bucket is sorted
+ * as one task. With TieBreak::RowID, runs of equal
+ * keys are found while breaking those ties and sorted by rowid_key(), so inputs without prefix ties pay nothing.
+ *
+ * @param keys          flat array of keys (index = chunk_id * CHUNKSIZE + chunk_offset)
+ * @param rowids        vector of RowID to sort in-place
+ * @param ctx           scheduler and thread cap to run with
+ * @param tie_break     order of RowIDs with equal keys
+ * @return              number of full-key comparisons needed to break prefix ties
+ */
+size_t prefix_sort_rowids(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx = ExecutionContext::global(),
+    TieBreak tie_break = TieBreak::Unspecified);
+
+inline void prefix_sort_wrapper(const KeyView &keys, std::vector<RowID> &rowids)
+{
+    prefix_sort_rowids(keys, rowids);
+}
@@ -13,26 +13,68 @@
 #include <pdqsort.h>
 
 #include "common.hpp"
-#include "thread_pool.hpp"
+#include "task_scheduler.hpp"
+#include "algorithms/partition.hpp"
+#include "algorithms/tie_break.hpp"
 
-constexpr size_t RADIX = 256; // byte = 0–255
+// Buckets smaller than this are handed to pdqsort instead of being partitioned on the next byte
+const size_t MSD_RADIX_CUTOFF = getenv("MSD_RADIX_CUTOFF", size_t(64));
 
 // LSD Radix Sort for equal-length keys
-void radix_sort(std::vector<ByteKey> &keys);
+void radix_sort(KeyArena &keys);
 
-void radix_sort_parallel_msb(std::vector<ByteKey> &keys, size_t sort_byte_index = 0);
+void radix_sort_parallel_msb(
+    KeyArena &keys,
+    size_t sort_byte_index = 0,
+    const ExecutionContext &ctx = ExecutionContext::global());
 
-inline void parallel_radix_wrapper(std::vector<ByteKey> &keys)
+inline void parallel_radix_wrapper(KeyArena &keys)
 {
     radix_sort_parallel_msb(keys, 0); // Sort by the 1st byte (MSB)
 }
 
 /**
- * Hybrid MSB-radix + std::sort for RowIDs.
+ * Recursive MSD radix sort of a RowID range on the key bytes from byte_index onwards.
+ *
+ * Partitions on one byte per level, skips bytes that are constant within a bucket, stops at the end of the key
+ * and sorts buckets smaller than cutoff with pdqsort.
+ *
+ * @param keys          flat array of keys (index = chunk_id * CHUNKSIZE + chunk_offset)
+ * @param rowids        first RowID of the range to sort in-place
+ * @param scratch       scratch space for at least n RowIDs
+ * @param n             number of RowIDs in the range
+ * @param byte_index    first key byte that may still differ within the range
+ * @param cutoff        bucket size below which pdqsort takes over
+ */
+void msd_radix_sort_rowids(
+    const KeyView &keys,
+    RowID *rowids,
+    RowID *scratch,
+    size_t n,
+    size_t byte_index,
+    size_t cutoff = MSD_RADIX_CUTOFF);
+
+/**
+ * Hybrid MSB-radix + pdqsort for RowIDs.
+ *
+ * Splits on the first byte in parallel and sorts every bucket with msd_radix_sort_rowids.
  *
  * @param rowids        vector of RowID to sort in-place
  * @param keys          flat array of keys (index = chunk_id * CHUNKSIZE + chunk_offset)
+ * @param ctx           scheduler and thread cap to run with
+ * @param cutoff        bucket size below which pdqsort takes over
+ * @param tie_break     order of RowIDs with equal keys
  */
 void hybrid_radix_sort_rowids_msb(
-    const std::vector<ByteKey> &keys,
-    std::vector<RowID> &rowids);
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    size_t cutoff = MSD_RADIX_CUTOFF,
+    TieBreak tie_break = TieBreak::Unspecified);
+
+inline void hybrid_radix_sort_rowids_msb(
+    const KeyView &keys,
+    std::vector<RowID> &rowids)
+{
+    hybrid_radix_sort_rowids_msb(keys, rowids, ExecutionContext::global());
+}
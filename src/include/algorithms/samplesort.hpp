@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+#include "rowid.hpp"
+#include "common.hpp"
+#include "task_scheduler.hpp"
+#include "algorithms/tie_break.hpp"
+
+/**
+ * Parallel in-place samplesort for RowIDs in the style of IPS4o.
+ *
+ * Every level draws an oversampled set of splitters and classifies the RowIDs into up to 255 buckets by
+ * descending a branch-free splitter tree, several keys at a time so their cache misses overlap. Buckets that
+ * hold a single splitter key ("equality buckets") need no further sorting, which keeps heavy duplicates from
+ * recursing. Classified RowIDs are collected in small per-thread buffers and written back as full blocks, and
+ * the blocks are then permuted into their buckets, so besides the RowIDs only O(threads * buckets * block size)
+ * extra memory is used. Buckets larger than one thread's share are partitioned again with all threads, the
+ * rest are sorted as independent tasks; subproblems of at most 1024 RowIDs go to pdqsort.
+ *
+ * @param keys          flat array of keys (index = chunk_id * CHUNKSIZE + chunk_offset)
+ * @param rowids        vector of RowID to sort in-place
+ * @param ctx           scheduler and thread cap to run with
+ * @param tie_break     order of RowIDs with equal keys
+ */
+void samplesort_rowids(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    TieBreak tie_break = TieBreak::Unspecified);
+
+inline void samplesort_rowids(
+    const KeyView &keys,
+    std::vector<RowID> &rowids)
+{
+    samplesort_rowids(keys, rowids, ExecutionContext::global());
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Largest input the small sort accepts
+constexpr size_t SMALL_SORT_MAX = 256;
+
+/**
+ * Branch-free sort of up to SMALL_SORT_MAX {64-bit key prefix, 32-bit index} pairs by prefix.
+ *
+ * Runs a bitonic sorting network over the input padded to a power of two. The AVX-512 or AVX2 kernel is chosen
+ * once at runtime from the CPU features (see simd_isa.hpp), with a scalar network as the fallback. Equal
+ * prefixes end up in unspecified order, so callers that need a total order break ties on the remaining key
+ * bytes afterwards.
+ *
+ * @param prefixes      big-endian key prefixes, sorted in-place
+ * @param indices       payload moved along with every prefix
+ * @param n             number of pairs, at most SMALL_SORT_MAX
+ */
+void small_sort(uint64_t *prefixes, uint32_t *indices, size_t n);
+
+// Whether small_sort() runs a SIMD kernel. The scalar network does O(n log^2 n) comparisons and is no faster
+// than pdqsort, so leaf sorts only switch to it when this is true.
+bool small_sort_vectorized();
+
+// The individual kernels; the SIMD ones may only be called when the CPU supports them
+void small_sort_scalar(uint64_t *prefixes, uint32_t *indices, size_t n);
+void small_sort_avx2(uint64_t *prefixes, uint32_t *indices, size_t n);
+void small_sort_avx512(uint64_t *prefixes, uint32_t *indices, size_t n);
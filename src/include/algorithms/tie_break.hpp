@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "rowid.hpp"
+#include "common.hpp"
+#include "var_key_arena.hpp"
+#include "task_scheduler.hpp"
+
+// How a sort orders RowIDs whose keys are equal
+enum class TieBreak
+{
+    // Whatever order the engine leaves them in, which may change with the thread count and from run to run
+    Unspecified,
+    // Ascending (chunk_id, chunk_offset), so equal inputs always give the same output. For RowIDs that come in
+    // ascending order this is a stable sort.
+    RowID,
+};
+
+/**
+ * Orders every run of equal keys in sorted RowIDs by RowID.
+ *
+ * Runs are found with one parallel pass over adjacent pairs, one key comparison each, and sorted by rowid_key()
+ * with integer compares, so no key is compared twice. Runs that are already in RowID order, such as the groups of
+ * the stable count sort, are only checked.
+ *
+ * @param keys          flat array of keys (index = chunk_id * CHUNKSIZE + chunk_offset)
+ * @param rowids        RowIDs sorted by key
+ * @param ctx           scheduler and thread cap to run with
+ * @param group_starts  start of every group of equal keys, followed by rowids.size(), if already known
+ */
+void order_ties_by_rowid(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    const std::vector<size_t> *group_starts = nullptr);
+
+// Same for RowIDs sorted by variable-length keys
+void order_ties_by_rowid(
+    const VarKeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include "rowid.hpp"
+#include "common.hpp"
+#include "task_scheduler.hpp"
+#include "algorithms/tie_break.hpp"
+
+// LIMIT the benchmark uses for the top-K sort
+const size_t TOP_K_LIMIT = getenv("TOP_K", size_t(1000));
+
+/**
+ * Partial sort for ORDER BY ... LIMIT ... OFFSET: keeps only the RowIDs at sorted positions
+ * [offset, offset + limit), in sorted order.
+ *
+ * Every thread scans its share of the input once into a bounded max-heap of offset + limit {8-byte key prefix,
+ * RowID} records. Full heaps publish their largest prefix as a shared threshold, so most RowIDs are rejected by a
+ * single integer comparison without touching the rest of their key. The surviving candidates of all heaps are
+ * narrowed down to the window with nth_element and only those are sorted. When the window covers a large part of
+ * the input, the RowIDs are fully sorted and truncated instead.
+ *
+ * @param keys          flat array of keys (index = chunk_id * CHUNKSIZE + chunk_offset)
+ * @param rowids        RowIDs to select from; replaced by the sorted window
+ * @param offset        number of leading RowIDs in sort order to skip
+ * @param limit         maximum number of RowIDs to return
+ * @param ctx           scheduler and thread cap to run with
+ * @param tie_break     order of RowIDs with equal keys; with TieBreak::RowID, equal keys at the window edges
+ *                      select the smallest RowIDs
+ */
+void top_k_rowids(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    size_t offset,
+    size_t limit,
+    const ExecutionContext &ctx,
+    TieBreak tie_break = TieBreak::Unspecified);
+
+inline void top_k_rowids(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    size_t offset,
+    size_t limit)
+{
+    top_k_rowids(keys, rowids, offset, limit, ExecutionContext::global());
+}
+
+inline void top_k_wrapper(const KeyView &keys, std::vector<RowID> &rowids)
+{
+    top_k_rowids(keys, rowids, 0, TOP_K_LIMIT);
+}
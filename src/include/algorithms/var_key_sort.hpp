@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include "rowid.hpp"
+#include "var_key_arena.hpp"
+#include "task_scheduler.hpp"
+#include "algorithms/radix.hpp"
+#include "algorithms/tie_break.hpp"
+
+/**
+ * Hybrid MSD radix + pdqsort for RowIDs over variable-length keys.
+ *
+ * Every level partitions on one key byte into 257 buckets: bucket 0 holds the keys that end before that byte and
+ * comes first, bytes 0-255 map to buckets 1-256. Keys in bucket 0 agree on all of their bytes, so that bucket is
+ * finished. Like hybrid_radix_sort_rowids_msb, oversized buckets are split with all threads, bytes that are
+ * constant within a bucket are skipped and buckets smaller than cutoff are sorted with VarKeyLess, which only
+ * reads the string heap when the inline prefixes tie.
+ *
+ * @param keys          variable-length keys (index = chunk_id * CHUNKSIZE + chunk_offset)
+ * @param rowids        vector of RowID to sort in-place
+ * @param ctx           scheduler and thread cap to run with
+ * @param cutoff        bucket size below which pdqsort takes over
+ * @param tie_break     order of RowIDs with equal keys
+ */
+void var_key_sort_rowids(
+    const VarKeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    size_t cutoff = MSD_RADIX_CUTOFF,
+    TieBreak tie_break = TieBreak::Unspecified);
+
+inline void var_key_sort_rowids(
+    const VarKeyView &keys,
+    std::vector<RowID> &rowids)
+{
+    var_key_sort_rowids(keys, rowids, ExecutionContext::global());
+}
@@ -2,13 +2,15 @@
 
 #include <vector>
 #include <cstdint>
+#include <cstdlib>
+#include <chrono>
 #include <iostream>
 #include <algorithm>
+#include <limits>
+#include <string>
 
 #include "rowid.hpp"
-
-// Alias for clarity
-using ByteKey = std::vector<uint8_t>;
+#include "key_arena.hpp"
 
 // Compute median from a vector of durations
 inline long long median(std::vector<long long> &times)
@@ -39,15 +41,38 @@ inline size_t getenv(const char *name, size_t default_value)
     return default_value;
 }
 
-const uint16_t CHUNK_SIZE = getenv("CHUNK_SIZE", std::numeric_limits<uint16_t>::max());
+inline double getenv(const char *name, double default_value)
+{
+    const char *value = std::getenv(name);
+    if (value)
+    {
+        try
+        {
+            return std::stod(value);
+        }
+        catch (const std::exception &)
+        {
+            return default_value;
+        }
+    }
+    return default_value;
+}
+
+const uint16_t CHUNK_SIZE = getenv("CHUNK_SIZE", size_t{std::numeric_limits<uint16_t>::max()});
+
+// Position of the key belonging to a RowID in the flat key array
+inline size_t row_index(const RowID &rid)
+{
+    return size_t{CHUNK_SIZE} * rid.chunk_id + rid.chunk_offset;
+}
 
 // Benchmarking function for any sort
-// sort_fn: void(std::vector<ByteKey>&)
+// sort_fn: void(const KeyView&, std::vector<RowID>&)
 // Returns median time in ms
 inline void benchmark_sort(
-    const std::vector<ByteKey> &keys,
+    const KeyView &keys,
     const std::vector<RowID> &original_row_ids,
-    void (*sort_fn)(const std::vector<ByteKey> &, std::vector<RowID> &),
+    void (*sort_fn)(const KeyView &, std::vector<RowID> &),
     const size_t N,
     const std::string &label)
 {
@@ -66,20 +91,6 @@ inline void benchmark_sort(
     std::cout << label << " median: " << med << " ms (" << N << " runs)\n";
 }
 
-inline void generate_keys(std::vector<ByteKey> &keys, size_t num_keys, size_t key_size)
-{
-    keys.reserve(num_keys);
-    for (size_t i = 0; i < num_keys; ++i)
-    {
-        ByteKey key(key_size);
-        for (size_t j = 0; j < key_size; ++j)
-        {
-            key[j] = 'a' + (rand() % 26); // Random char from 'a' to 'z'
-        }
-        keys.emplace_back(std::move(key));
-    }
-}
-
 inline void generate_row_ids(
     std::vector<RowID> &row_ids,
     const size_t num_keys)
@@ -87,7 +98,6 @@ inline void generate_row_ids(
     row_ids.reserve(num_keys);
 
     const uint32_t NUM_CHUNKS = (num_keys + CHUNK_SIZE - 1) / CHUNK_SIZE; // Round up division
-    std::cout << "Using " << NUM_CHUNKS << " chunks of size " << CHUNK_SIZE << std::endl;
 
     for (uint32_t chunk_id = 0; chunk_id < NUM_CHUNKS; ++chunk_id)
     {
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * Non-owning view over fixed-stride keys. Key i starts at data() + i * key_size(), so looking up a key is a
+ * single multiply-add without any pointer chasing.
+ */
+class KeyView
+{
+public:
+    KeyView() = default;
+
+    KeyView(const uint8_t *data, size_t num_keys, size_t key_size)
+        : _data(data), _num_keys(num_keys), _key_size(key_size) {}
+
+    const uint8_t *operator[](size_t index) const { return _data + index * _key_size; }
+
+    const uint8_t *data() const { return _data; }
+    size_t size() const { return _num_keys; }
+    size_t key_size() const { return _key_size; }
+    bool empty() const { return _num_keys == 0; }
+
+private:
+    const uint8_t *_data = nullptr;
+    size_t _num_keys = 0;
+    size_t _key_size = 0;
+};
+
+/**
+ * Owning storage for fixed-stride keys: one contiguous buffer of num_keys * key_size bytes instead of one heap
+ * allocation per key. Converts implicitly to a KeyView, which is what the sort entry points take.
+ */
+class KeyArena
+{
+public:
+    KeyArena() = default;
+
+    KeyArena(size_t num_keys, size_t key_size)
+        : _data(num_keys * key_size), _num_keys(num_keys), _key_size(key_size) {}
+
+    void resize(size_t num_keys, size_t key_size)
+    {
+        _data.resize(num_keys * key_size);
+        _num_keys = num_keys;
+        _key_size = key_size;
+    }
+
+    uint8_t *operator[](size_t index) { return _data.data() + index * _key_size; }
+    const uint8_t *operator[](size_t index) const { return _data.data() + index * _key_size; }
+
+    uint8_t *data() { return _data.data(); }
+    const uint8_t *data() const { return _data.data(); }
+    size_t size() const { return _num_keys; }
+    size_t key_size() const { return _key_size; }
+    bool empty() const { return _num_keys == 0; }
+
+    KeyView view() const { return KeyView(_data.data(), _num_keys, _key_size); }
+    operator KeyView() const { return view(); }
+
+    void swap(KeyArena &other) noexcept
+    {
+        _data.swap(other._data);
+        std::swap(_num_keys, other._num_keys);
+        std::swap(_key_size, other._key_size);
+    }
+
+private:
+    std::vector<uint8_t> _data;
+    size_t _num_keys = 0;
+    size_t _key_size = 0;
+};
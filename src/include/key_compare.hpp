@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+// Template argument for kernels that take the key width at runtime
+constexpr size_t DYNAMIC_KEY_SIZE = 0;
+
+/**
+ * Lexicographic key comparison for a key width known at compile time.
+ *
+ * Keys are loaded as big-endian 16-, 8- and 4-byte words, which compare like the bytes they hold, so a 16-byte
+ * key costs one 128-bit comparison instead of a memcmp call. The word loop has a constant trip count and
+ * unrolls completely.
+ *
+ * @tparam KeySize      key width in bytes, or DYNAMIC_KEY_SIZE to compare key_size bytes with memcmp
+ */
+template <size_t KeySize>
+class KeyLess
+{
+public:
+    explicit KeyLess(size_t = KeySize) {}
+
+    static constexpr size_t key_size() { return KeySize; }
+
+    bool operator()(const uint8_t *a, const uint8_t *b) const
+    {
+        size_t i = 0;
+        for (; i + 16 <= KeySize; i += 16)
+        {
+            const unsigned __int128 x = load_be128(a + i);
+            const unsigned __int128 y = load_be128(b + i);
+            if (x != y)
+                return x < y;
+        }
+        if constexpr (KeySize % 16 >= 8)
+        {
+            const uint64_t x = load_be64(a + i);
+            const uint64_t y = load_be64(b + i);
+            if (x != y)
+                return x < y;
+            i += 8;
+        }
+        if constexpr (KeySize % 8 >= 4)
+        {
+            const uint32_t x = load_be32(a + i);
+            const uint32_t y = load_be32(b + i);
+            if (x != y)
+                return x < y;
+            i += 4;
+        }
+        for (; i < KeySize; ++i)
+        {
+            if (a[i] != b[i])
+                return a[i] < b[i];
+        }
+        return false;
+    }
+
+private:
+    static uint32_t load_be32(const uint8_t *p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return __builtin_bswap32(value);
+    }
+
+    static uint64_t load_be64(const uint8_t *p)
+    {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return __builtin_bswap64(value);
+    }
+
+    static unsigned __int128 load_be128(const uint8_t *p)
+    {
+        return (static_cast<unsigned __int128>(load_be64(p)) << 64) | load_be64(p + 8);
+    }
+};
+
+template <>
+class KeyLess<DYNAMIC_KEY_SIZE>
+{
+public:
+    explicit KeyLess(size_t key_size) : _key_size(key_size) {}
+
+    size_t key_size() const { return _key_size; }
+
+    bool operator()(const uint8_t *a, const uint8_t *b) const
+    {
+        return std::memcmp(a, b, _key_size) < 0;
+    }
+
+private:
+    size_t _key_size;
+};
+
+/**
+ * Calls fn with std::integral_constant<size_t, W> for the key widths that have specialized kernels
+ * (4, 8, 12, 16, 24 and 32 bytes) and with DYNAMIC_KEY_SIZE for every other width.
+ */
+template <typename Fn>
+decltype(auto) dispatch_key_size(size_t key_size, Fn &&fn)
+{
+    switch (key_size)
+    {
+    case 4:
+        return fn(std::integral_constant<size_t, 4>{});
+    case 8:
+        return fn(std::integral_constant<size_t, 8>{});
+    case 12:
+        return fn(std::integral_constant<size_t, 12>{});
+    case 16:
+        return fn(std::integral_constant<size_t, 16>{});
+    case 24:
+        return fn(std::integral_constant<size_t, 24>{});
+    case 32:
+        return fn(std::integral_constant<size_t, 32>{});
+    default:
+        return fn(std::integral_constant<size_t, DYNAMIC_KEY_SIZE>{});
+    }
+}
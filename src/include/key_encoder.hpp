@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include "key_arena.hpp"
+#include "task_scheduler.hpp"
+
+// Value type of a sort column
+enum class ColumnType
+{
+    Int32,
+    Int64,
+    UInt32,
+    UInt64,
+    Float32,
+    Float64,
+    String, // data points to std::string_view
+};
+
+enum class SortOrder
+{
+    Ascending,
+    Descending,
+};
+
+enum class NullOrder
+{
+    NullsFirst,
+    NullsLast,
+};
+
+/**
+ * One ORDER BY column. data points to num_rows values of the column type; validity, if set, holds one byte per
+ * row that is 0 for NULL.
+ */
+struct SortColumn
+{
+    ColumnType type;
+    const void *data;
+    const uint8_t *validity = nullptr;
+    SortOrder order = SortOrder::Ascending;
+    NullOrder nulls = NullOrder::NullsLast;
+    // Key bytes a String column gets after its common prefix; longer strings are truncated
+    size_t string_width = 0;
+};
+
+/**
+ * Bytes one row's key takes: per column one NULL byte if it has a validity mask, plus the value width (4 or 8 bytes
+ * for numbers, string_width for strings).
+ */
+size_t encoded_key_size(const std::vector<SortColumn> &columns);
+
+/**
+ * Builds memcmp-comparable normalized keys from typed columns, so that the byte order of the keys is the
+ * ORDER BY order of the rows. The columns are laid out one after another in every key:
+ *
+ * - nullable columns start with a NULL byte that puts NULLs first or last regardless of the sort order;
+ *   the value bytes of a NULL are zero
+ * - integers are stored big-endian, signed ones with the sign bit flipped
+ * - floats get the sign bit flipped when positive and all bits flipped when negative; -0.0 is encoded as 0.0
+ *   and every NaN as the same NaN, which sorts after infinity
+ * - strings skip the longest prefix all rows of the column share, which cannot change the order, then take up
+ *   to string_width bytes padded with zeros. Strings that only differ behind that window, or by trailing zero
+ *   bytes, get equal keys.
+ * - descending columns have their value bytes inverted
+ *
+ * Rows are encoded in parallel batches, column by column within a batch, directly into keys.
+ *
+ * @param columns       ORDER BY columns, most significant first
+ * @param num_rows      number of rows in every column
+ * @param keys          resized to num_rows keys of encoded_key_size(columns) bytes; key i belongs to row i
+ * @param ctx           scheduler and thread cap to run with
+ */
+void encode_keys(
+    const std::vector<SortColumn> &columns,
+    size_t num_rows,
+    KeyArena &keys,
+    const ExecutionContext &ctx = ExecutionContext::global());
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "key_arena.hpp"
+
+constexpr char KEY_FILE_MAGIC[8] = {'S', 'O', 'R', 'T', 'K', 'E', 'Y', 'S'};
+constexpr uint32_t KEY_FILE_VERSION = 1;
+
+/**
+ * Header of a binary key file. It is followed directly by num_keys * key_size key bytes in the same fixed-stride
+ * layout as a KeyArena, so key i starts at byte sizeof(KeyFileHeader) + i * key_size. All fields are stored in
+ * native byte order.
+ */
+struct KeyFileHeader
+{
+    char magic[8];       // KEY_FILE_MAGIC
+    uint32_t version;    // KEY_FILE_VERSION
+    uint32_t key_size;   // bytes per key
+    uint64_t num_keys;   // number of keys
+    uint64_t chunk_size; // RowIDs per chunk the keys were exported with
+};
+static_assert(sizeof(KeyFileHeader) == 32, "the key file header has a fixed on-disk size");
+
+// How MappedKeyFile gets the key pages into memory
+enum class KeyFileLoad
+{
+    // Pages fault in on first access, during the first sort
+    Lazy = 0,
+    // madvise(MADV_WILLNEED): the kernel starts reading the whole file in the background
+    WillNeed = 1,
+    // MAP_POPULATE: mapping blocks until every page is resident, so no sort pays for page faults
+    Prefault = 2,
+};
+
+/**
+ * Read-only memory mapping of a key file. The keys are used in place: view() points into the mapping, so
+ * opening a file costs no copy regardless of its size. Throws std::system_error if the file cannot be opened or
+ * mapped and std::runtime_error if it is not a valid key file.
+ */
+class MappedKeyFile
+{
+public:
+    explicit MappedKeyFile(const std::string &path, KeyFileLoad load = KeyFileLoad::WillNeed);
+    ~MappedKeyFile();
+
+    MappedKeyFile(const MappedKeyFile &) = delete;
+    MappedKeyFile &operator=(const MappedKeyFile &) = delete;
+
+    KeyView view() const { return KeyView(_keys, _num_keys, _key_size); }
+    operator KeyView() const { return view(); }
+
+    size_t size() const { return _num_keys; }
+    size_t key_size() const { return _key_size; }
+    size_t chunk_size() const { return _chunk_size; }
+
+private:
+    void *_mapping = nullptr;
+    size_t _mapping_size = 0;
+    const uint8_t *_keys = nullptr;
+    size_t _num_keys = 0;
+    size_t _key_size = 0;
+    size_t _chunk_size = 0;
+};
+
+/**
+ * Writes keys as a key file at path, replacing any existing file. Throws std::system_error on I/O errors.
+ *
+ * @param chunk_size    RowIDs per chunk to record in the header
+ */
+void write_key_file(const std::string &path, const KeyView &keys, size_t chunk_size);
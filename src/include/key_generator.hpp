@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+#include "key_arena.hpp"
+#include "task_scheduler.hpp"
+
+// Shape of generated keys. Unless noted otherwise, key bytes are uniform over all 256 values.
+enum class KeyDistribution
+{
+    Uniform,
+    // Copies of cardinality distinct keys, the one of rank r drawn with probability proportional to 1 / r^zipf_exponent
+    Zipf,
+    // Copies of cardinality distinct keys, all equally likely
+    FewUnique,
+    // Ascending keys, spread evenly over the space of their first 8 bytes
+    Sorted,
+    // Descending keys
+    Reverse,
+    // Sorted keys with swap_percent % of them swapped with another random key
+    NearlySorted,
+    // One random prefix of prefix_length bytes shared by every key, then uniform bytes
+    SharedPrefix,
+    // Ascending in the first half, descending in the second
+    OrganPipe,
+};
+
+struct KeyGeneratorOptions
+{
+    KeyDistribution distribution = KeyDistribution::Uniform;
+    uint64_t seed = 42;
+    // Distinct keys of Zipf and FewUnique
+    size_t cardinality = 1000;
+    double zipf_exponent = 1.0;
+    double swap_percent = 1.0;
+    // Shared bytes of SharedPrefix; 0 shares all but the last 4 bytes
+    size_t prefix_length = 0;
+};
+
+// The counter-th random word of the counter-based generator behind generate_keys; index is a key, a row or a rank
+uint64_t random_word(uint64_t seed, uint64_t index, uint64_t counter);
+
+// Name of a distribution as accepted by parse_key_distribution, e.g. "nearly_sorted"
+const char *key_distribution_name(KeyDistribution distribution);
+
+// Distribution with the given name; throws std::invalid_argument for unknown names
+KeyDistribution parse_key_distribution(std::string_view name);
+
+/**
+ * Fills keys with num_keys keys of the given distribution in parallel.
+ *
+ * Every random value comes from a counter-based generator: a hash of the seed, the key index and the position in
+ * the key, so the keys only depend on the options and never on the thread count or schedule. The only serial step
+ * is applying the swaps of NearlySorted, one per swap_percent % of the keys.
+ *
+ * @param keys          resized to num_keys keys of key_size bytes
+ * @param num_keys      number of keys to generate
+ * @param key_size      bytes per key
+ * @param options       distribution, seed and distribution parameters
+ * @param ctx           scheduler and thread cap to run with
+ */
+void generate_keys(
+    KeyArena &keys,
+    size_t num_keys,
+    size_t key_size,
+    const KeyGeneratorOptions &options,
+    const ExecutionContext &ctx = ExecutionContext::global());
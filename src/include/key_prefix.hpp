@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+#include "rowid.hpp"
+#include "common.hpp"
+#include "key_compare.hpp"
+
+/**
+ * Loads up to 8 key bytes starting at offset as a big-endian integer, so that comparing two prefixes as
+ * uint64_t gives the same order as memcmp on those bytes. Bytes past the end of the key are zero.
+ */
+inline uint64_t load_key_prefix(const uint8_t *key, size_t key_size, size_t offset = 0)
+{
+    if (key_size >= offset + 8)
+    {
+        uint64_t value;
+        std::memcpy(&value, key + offset, sizeof(value));
+        return __builtin_bswap64(value);
+    }
+    uint64_t value = 0;
+    for (size_t i = offset; i < key_size; ++i)
+    {
+        value |= uint64_t{key[i]} << (56 - 8 * (i - offset));
+    }
+    return value;
+}
+
+// Sort record that keeps the first 8 key bytes next to the RowID they belong to
+struct PrefixRecord
+{
+    uint64_t prefix;
+    RowID rowid;
+};
+
+// Width of the key bytes after the prefix, the size to dispatch PrefixRecordLess on
+inline size_t prefix_tail_size(size_t key_size)
+{
+    return key_size - std::min<size_t>(8, key_size);
+}
+
+/**
+ * Orders PrefixRecords like their full keys: by prefix, and on equal prefixes by the key bytes after it.
+ *
+ * @tparam TailSize     prefix_tail_size() of the keys, or DYNAMIC_KEY_SIZE
+ */
+template <size_t TailSize>
+struct PrefixRecordLess
+{
+    KeyView keys;
+    size_t offset;
+    KeyLess<TailSize> less;
+
+    explicit PrefixRecordLess(const KeyView &keys)
+        : keys(keys), offset(std::min<size_t>(8, keys.key_size())), less(prefix_tail_size(keys.key_size())) {}
+
+    bool operator()(const PrefixRecord &a, const PrefixRecord &b) const
+    {
+        if (a.prefix != b.prefix)
+            return a.prefix < b.prefix;
+        return less(keys[row_index(a.rowid)] + offset, keys[row_index(b.rowid)] + offset);
+    }
+};
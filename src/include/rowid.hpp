@@ -27,3 +27,9 @@ public:
     uint32_t chunk_id;
     uint16_t chunk_offset;
 };
+
+// RowID as one integer that orders like (chunk_id, chunk_offset), for tie-breaking on RowIDs with integer compares
+inline uint64_t rowid_key(const RowID &rid)
+{
+    return uint64_t{rid.chunk_id} << 16 | rid.chunk_offset;
+}
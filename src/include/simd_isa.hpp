@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+#include "common.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SORT_SIMD_X86 1
+#else
+#define SORT_SIMD_X86 0
+#endif
+
+#if SORT_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// Instruction sets the SIMD kernels are compiled for, in increasing order
+enum class SimdIsa
+{
+    Scalar = 0,
+    Avx2 = 1,
+    Avx512 = 2,
+};
+
+/**
+ * Best instruction set supported by the CPU, detected once per process. SIMD_MAX_ISA caps it
+ * (0 = scalar, 1 = AVX2, 2 = AVX-512) so every kernel variant can be benchmarked on one machine.
+ */
+inline SimdIsa simd_isa()
+{
+    static const SimdIsa isa = []
+    {
+        const size_t max_isa = getenv("SIMD_MAX_ISA", size_t(2));
+#if SORT_SIMD_X86
+        if (max_isa >= 2 && __builtin_cpu_supports("avx512f"))
+            return SimdIsa::Avx512;
+        if (max_isa >= 1 && __builtin_cpu_supports("avx2"))
+            return SimdIsa::Avx2;
+#endif
+        (void)max_isa;
+        return SimdIsa::Scalar;
+    }();
+    return isa;
+}
+
+inline const char *simd_isa_name(SimdIsa isa)
+{
+    switch (isa)
+    {
+    case SimdIsa::Avx512:
+        return "avx512";
+    case SimdIsa::Avx2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+#if SORT_SIMD_X86
+// Unsigned 64-bit a > b per lane. AVX2 only has a signed 64-bit compare; flipping the sign bit makes it unsigned.
+inline __attribute__((target("avx2"))) __m256i cmpgt_epu64(__m256i a, __m256i b)
+{
+    const __m256i sign = _mm256_set1_epi64x(std::numeric_limits<int64_t>::min());
+    return _mm256_cmpgt_epi64(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+}
+#endif
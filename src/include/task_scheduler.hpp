@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class TaskGroup;
+class ExecutionContext;
+
+/**
+ * A spawned task: the callable is stored inline, so spawning does not allocate. Callables must be trivially
+ * copyable and fit into STORAGE_SIZE bytes, i.e. capture by reference or capture a few indices by value.
+ */
+struct Task
+{
+    static constexpr size_t STORAGE_SIZE = 64;
+
+    void (*invoke)(void *storage) = nullptr;
+    TaskGroup *group = nullptr;
+    alignas(std::max_align_t) unsigned char storage[STORAGE_SIZE];
+};
+
+/**
+ * Work-stealing task scheduler. Every worker owns a deque: it pushes and pops its own tasks at the back and
+ * steals from the front of other workers' deques when it runs dry, so there is no global queue lock. Tasks are
+ * spawned and joined through a TaskGroup.
+ */
+class TaskScheduler
+{
+public:
+    /**
+     * @param num_threads   number of worker threads
+     * @param pin_threads   pin worker i to the i-th CPU the process may run on
+     */
+    explicit TaskScheduler(size_t num_threads = std::thread::hardware_concurrency(), bool pin_threads = false);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler &) = delete;
+    TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+    size_t num_threads() const { return _workers.size(); }
+
+    /**
+     * Process-wide scheduler shared by all sort calls, started on first use. NUM_THREADS sets the number of
+     * workers (default: hardware concurrency) and PIN_THREADS=1 pins them to cores.
+     */
+    static TaskScheduler &global();
+
+    /**
+     * Time each worker spent running tasks since construction or the last reset_busy_times(), followed by one
+     * caller slot: the time threads outside the scheduler spent running tasks inline in spawn() or while waiting
+     * in sync(), which would otherwise not show up anywhere.
+     */
+    std::vector<std::chrono::nanoseconds> busy_times() const;
+    void reset_busy_times();
+
+    /**
+     * Charges the time until it goes out of scope to the caller slot of busy_times(), unless the calling thread is
+     * a worker of the scheduler (whose task is timed already) or is in an outer CallerTimer.
+     */
+    class CallerTimer
+    {
+    public:
+        explicit CallerTimer(TaskScheduler &scheduler);
+        ~CallerTimer();
+
+        CallerTimer(const CallerTimer &) = delete;
+        CallerTimer &operator=(const CallerTimer &) = delete;
+
+    private:
+        TaskScheduler *_scheduler = nullptr; // nullptr if not timing
+        std::chrono::steady_clock::time_point _start;
+    };
+
+private:
+    friend class TaskGroup;
+
+    struct alignas(64) WorkerQueue
+    {
+        std::mutex mutex;
+        std::vector<Task> ring;
+        size_t head = 0;              // index of the oldest task (steal end)
+        std::atomic<size_t> size{0}; // written under the mutex, peeked without it by thieves
+        std::atomic<uint64_t> busy_ns{0};
+    };
+
+    // Pushes onto the calling worker's deque, or onto a round-robin deque for external threads
+    void submit(const Task &task);
+
+    // Pops from the calling worker's own deque first, then tries to steal from the others
+    bool try_get_task(Task &task);
+
+    void execute(Task &task);
+    void worker_loop(size_t index, bool pin_thread);
+
+    std::vector<std::unique_ptr<WorkerQueue>> _queues;
+    std::vector<std::thread> _workers;
+
+    std::atomic<uint64_t> _caller_busy_ns{0};
+    std::atomic<size_t> _queued{0};
+    std::atomic<size_t> _sleeping{0};
+    std::atomic<size_t> _next_queue{0};
+    std::atomic<bool> _stop{false};
+    std::mutex _sleep_mutex;
+    std::condition_variable _wake;
+};
+
+/**
+ * Execution resources of one sort call: the scheduler it runs on and how many of its workers it may keep busy
+ * at once, so that concurrent sorts do not oversubscribe the machine. Every parallel sort entry point takes one;
+ * the overloads without it use ExecutionContext::global().
+ */
+class ExecutionContext
+{
+public:
+    /**
+     * @param scheduler     scheduler to run on
+     * @param max_threads   maximum number of workers the sort may use, 0 for all of them
+     */
+    ExecutionContext(TaskScheduler &scheduler, size_t max_threads = 0)
+        : _scheduler(&scheduler), _max_threads(max_threads) {}
+
+    TaskScheduler &scheduler() const { return *_scheduler; }
+
+    // Number of workers the sort may use; sorts size their parallel phases by this
+    size_t num_threads() const
+    {
+        const size_t available = _scheduler->num_threads();
+        return _max_threads == 0 ? available : std::min(_max_threads, available);
+    }
+
+    // Maximum number of tasks a sort keeps in flight, unlimited if the whole scheduler is available
+    size_t max_tasks() const { return _max_threads == 0 ? SIZE_MAX : num_threads(); }
+
+    /**
+     * Runs on TaskScheduler::global(). MAX_SORT_THREADS caps the number of workers per sort (default: all).
+     */
+    static const ExecutionContext &global();
+
+private:
+    TaskScheduler *_scheduler;
+    size_t _max_threads;
+};
+
+/**
+ * Fork-join scope: spawn() hands tasks to the scheduler, sync() waits for all of them and runs pending tasks
+ * while waiting. Tasks may spawn further tasks into the same group. The first exception thrown by a task is
+ * rethrown from sync().
+ *
+ * When created from an ExecutionContext with a thread cap, spawn() runs the task on the calling thread once the
+ * group already has that many tasks queued or running.
+ */
+class TaskGroup
+{
+public:
+    explicit TaskGroup(TaskScheduler &scheduler) : _scheduler(scheduler) {}
+    explicit TaskGroup(const ExecutionContext &ctx) : _scheduler(ctx.scheduler()), _max_pending(ctx.max_tasks()) {}
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    template <class F>
+    void spawn(F &&f)
+    {
+        using Fn = std::decay_t<F>;
+        static_assert(sizeof(Fn) <= Task::STORAGE_SIZE, "task does not fit inline; capture by reference");
+        static_assert(std::is_trivially_copyable<Fn>::value && std::is_trivially_destructible<Fn>::value,
+                      "tasks are copied bitwise; capture by reference or capture trivial values");
+
+        if (_pending.load(std::memory_order_relaxed) >= _max_pending)
+        {
+            const TaskScheduler::CallerTimer timer(_scheduler);
+            f();
+            return;
+        }
+
+        Task task;
+        task.invoke = [](void *storage)
+        { (*static_cast<Fn *>(storage))(); };
+        task.group = this;
+        new (task.storage) Fn(std::forward<F>(f));
+
+        _pending.fetch_add(1, std::memory_order_relaxed);
+        _scheduler.submit(task);
+    }
+
+    void sync();
+
+    TaskScheduler &scheduler() const { return _scheduler; }
+
+private:
+    friend class TaskScheduler;
+
+    void set_exception(std::exception_ptr exception);
+
+    TaskScheduler &_scheduler;
+    const size_t _max_pending = SIZE_MAX;
+    std::atomic<size_t> _pending{0};
+    std::mutex _exception_mutex;
+    std::exception_ptr _exception;
+};
+
+// Runs f1 and f2 in parallel and returns once both are done
+template <class F1, class F2>
+void parallel_invoke(const ExecutionContext &ctx, F1 &&f1, F2 &&f2)
+{
+    TaskGroup group(ctx);
+    group.spawn([&f2]
+                { f2(); });
+    {
+        const TaskScheduler::CallerTimer timer(ctx.scheduler());
+        f1();
+    }
+    group.sync();
+}
+
+// Rows per part below which adding threads does not pay off
+constexpr size_t MIN_ROWS_PER_PART = 1 << 16;
+
+// Number of parts to split num_rows rows into for parallel_for: one per thread, but at least min_rows each
+inline size_t num_parallel_parts(const ExecutionContext &ctx, size_t num_rows, size_t min_rows = MIN_ROWS_PER_PART)
+{
+    return std::max<size_t>(1, std::min(ctx.num_threads(), num_rows / min_rows));
+}
+
+// Runs fn(i) for every i in [0, n) as separate tasks and returns once all are done
+template <class F>
+void parallel_for(const ExecutionContext &ctx, size_t n, F &&fn)
+{
+    if (n == 1)
+    {
+        const TaskScheduler::CallerTimer timer(ctx.scheduler());
+        fn(size_t{0});
+        return;
+    }
+    TaskGroup group(ctx);
+    for (size_t i = 0; i < n; ++i)
+        group.spawn([&fn, i]
+                    { fn(i); });
+    group.sync();
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Hardware events counted per phase; CPUs, VMs and kernels may not offer all of them
+enum class PerfEvent
+{
+    Cycles,
+    Instructions,
+    LLCMisses,
+    BranchMisses,
+    DTLBMisses,
+};
+
+constexpr size_t NUM_PERF_EVENTS = 5;
+
+const char *perf_event_name(PerfEvent event);
+
+// Totals of one phase over all threads and calls
+struct PhaseCounters
+{
+    size_t calls = 0;
+    // Summed over the threads, so parallel phases can take longer than the wall-clock time
+    std::chrono::nanoseconds time{0};
+    std::array<uint64_t, NUM_PERF_EVENTS> events = {};
+    // Calls whose counters only ran for part of the phase because the kernel multiplexed them with other events;
+    // their counts are scaled up to the full phase and are estimates
+    size_t multiplexed_calls = 0;
+};
+
+/**
+ * Collects the time and hardware counters of named sort phases (histogram, scatter, leaf sort, merge, gather).
+ *
+ * Every thread that enters a PerfPhase opens its own perf_event_open counter group for user-space cycles,
+ * instructions, LLC misses, branch misses and dTLB misses on first use, and reads it when the phase begins and
+ * ends. Events the system does not offer are left out; if none can be opened, for example because of
+ * perf_event_paranoid or a container seccomp profile, phases are timed only.
+ */
+class PerfProfiler final
+{
+public:
+    // The process-wide profiler, enabled from the start if SORT_PERF is set to a nonzero value
+    static PerfProfiler &global();
+
+    void set_enabled(bool enabled) { _enabled.store(enabled, std::memory_order_relaxed); }
+    bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * @return whether the given event could be counted by the threads that opened counters so far; probes the
+     *         calling thread if none has yet
+     */
+    bool event_available(PerfEvent event);
+
+    // Adds the counts of one finished phase
+    void add(const char *phase, const PhaseCounters &counters);
+
+    // Phases in the order they were first seen, with their totals since the last reset()
+    std::vector<std::pair<std::string, PhaseCounters>> phases() const;
+
+    void reset();
+
+    /**
+     * Prints one line per phase with its calls, time, events and instructions per cycle.
+     *
+     * @param runs          number of sort runs the totals cover; the values are printed per run
+     */
+    void report(std::ostream &out, size_t runs = 1);
+
+    // Called by the threads that open counters: which events they got, or why they got none
+    void note_counters(uint32_t available_mask, const std::string &error);
+
+private:
+    PerfProfiler();
+
+    std::atomic<bool> _enabled{false};
+    mutable std::mutex _mutex;
+    std::vector<std::pair<std::string, PhaseCounters>> _phases;
+    bool _probed = false;
+    uint32_t _available_mask = 0;
+    std::string _error;
+};
+
+/**
+ * Counts the calling thread from construction to destruction as one call of the named phase. Does nothing while
+ * the profiler is disabled. Phases nested on one thread count towards the outermost one, so work a thread runs
+ * inline while it waits inside a phase is not counted twice.
+ */
+class PerfPhase final
+{
+public:
+    explicit PerfPhase(const char *name)
+    {
+        if (PerfProfiler::global().enabled())
+            begin(name);
+    }
+
+    ~PerfPhase()
+    {
+        if (_name != nullptr)
+            end();
+    }
+
+    PerfPhase(const PerfPhase &) = delete;
+    PerfPhase &operator=(const PerfPhase &) = delete;
+
+private:
+    void begin(const char *name);
+    void end();
+
+    const char *_name = nullptr;
+    bool _outermost = false;
+    std::chrono::steady_clock::time_point _start;
+    std::array<uint64_t, NUM_PERF_EVENTS> _events;
+    // Nanoseconds the counter group was enabled and actually counting when the phase began
+    uint64_t _time_enabled = 0;
+    uint64_t _time_running = 0;
+};
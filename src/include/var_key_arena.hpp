@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+// Key bytes every variable-length key keeps in its fixed-size slot
+constexpr size_t VAR_KEY_INLINE_SIZE = 12;
+
+/**
+ * Fixed-size slot of a variable-length key: its length, its first VAR_KEY_INLINE_SIZE bytes padded with zeros,
+ * and where the rest of the key lives in the string heap. Keys that fit inline have no heap bytes.
+ */
+struct VarKey
+{
+    uint32_t length;
+    uint8_t prefix[VAR_KEY_INLINE_SIZE];
+    uint64_t overflow; // heap offset of key bytes [VAR_KEY_INLINE_SIZE, length)
+};
+
+static_assert(sizeof(VarKey) == 24, "VarKey slots are expected to be 24 bytes");
+static_assert(VAR_KEY_INLINE_SIZE == 12, "VarKeyLess compares the inline prefix as an 8-byte and a 4-byte word");
+
+/**
+ * Non-owning view over variable-length keys: an array of VarKey slots, indexed like KeyView, plus the string heap
+ * their overflow offsets point into.
+ */
+class VarKeyView
+{
+public:
+    VarKeyView() = default;
+
+    VarKeyView(const VarKey *keys, size_t num_keys, const uint8_t *heap)
+        : _keys(keys), _num_keys(num_keys), _heap(heap) {}
+
+    const VarKey &operator[](size_t index) const { return _keys[index]; }
+
+    // Byte i < key.length of a key
+    uint8_t byte(const VarKey &key, size_t i) const
+    {
+        return i < VAR_KEY_INLINE_SIZE ? key.prefix[i] : _heap[key.overflow + i - VAR_KEY_INLINE_SIZE];
+    }
+
+    // Key bytes after the inline prefix; only valid for keys longer than VAR_KEY_INLINE_SIZE
+    const uint8_t *overflow(const VarKey &key) const { return _heap + key.overflow; }
+
+    const VarKey *data() const { return _keys; }
+    const uint8_t *heap() const { return _heap; }
+    size_t size() const { return _num_keys; }
+    bool empty() const { return _num_keys == 0; }
+
+private:
+    const VarKey *_keys = nullptr;
+    size_t _num_keys = 0;
+    const uint8_t *_heap = nullptr;
+};
+
+/**
+ * Owning storage for variable-length keys: one VarKey slot per key and one heap buffer for the bytes that do not
+ * fit inline, so a key costs 24 bytes plus its length past the prefix instead of the longest key's length.
+ * Converts implicitly to a VarKeyView.
+ */
+class VarKeyArena
+{
+public:
+    VarKeyArena() = default;
+
+    void reserve(size_t num_keys, size_t heap_bytes)
+    {
+        _keys.reserve(num_keys);
+        _heap.reserve(heap_bytes);
+    }
+
+    void push_back(const uint8_t *key, size_t length)
+    {
+        VarKey slot{};
+        slot.length = static_cast<uint32_t>(length);
+        std::memcpy(slot.prefix, key, std::min(length, VAR_KEY_INLINE_SIZE));
+        if (length > VAR_KEY_INLINE_SIZE)
+        {
+            slot.overflow = _heap.size();
+            _heap.insert(_heap.end(), key + VAR_KEY_INLINE_SIZE, key + length);
+        }
+        _keys.push_back(slot);
+    }
+
+    void push_back(std::string_view key)
+    {
+        push_back(reinterpret_cast<const uint8_t *>(key.data()), key.size());
+    }
+
+    void clear()
+    {
+        _keys.clear();
+        _heap.clear();
+    }
+
+    const VarKey &operator[](size_t index) const { return _keys[index]; }
+
+    size_t size() const { return _keys.size(); }
+    bool empty() const { return _keys.empty(); }
+    size_t heap_size() const { return _heap.size(); }
+
+    VarKeyView view() const { return VarKeyView(_keys.data(), _keys.size(), _heap.data()); }
+    operator VarKeyView() const { return view(); }
+
+private:
+    std::vector<VarKey> _keys;
+    std::vector<uint8_t> _heap;
+};
+
+/**
+ * Lexicographic order of variable-length keys, where a key that is a prefix of another sorts first.
+ *
+ * The inline prefixes are compared as one big-endian 8-byte and one 4-byte word. Only when they tie are the
+ * lengths consulted, and the heap is only read when both keys continue past the prefix.
+ */
+class VarKeyLess
+{
+public:
+    explicit VarKeyLess(const VarKeyView &keys) : _keys(keys) {}
+
+    bool operator()(const VarKey &a, const VarKey &b) const
+    {
+        const uint64_t a_high = load_be64(a.prefix), b_high = load_be64(b.prefix);
+        if (a_high != b_high)
+            return a_high < b_high;
+        const uint32_t a_low = load_be32(a.prefix + 8), b_low = load_be32(b.prefix + 8);
+        if (a_low != b_low)
+            return a_low < b_low;
+
+        // Equal prefixes: the zero padding of a short key matched real bytes of the other one, so unless both keys
+        // continue past the prefix the shorter one is a prefix of the longer one
+        if (a.length > VAR_KEY_INLINE_SIZE && b.length > VAR_KEY_INLINE_SIZE)
+        {
+            const size_t common = std::min(a.length, b.length) - VAR_KEY_INLINE_SIZE;
+            const int c = std::memcmp(_keys.overflow(a), _keys.overflow(b), common);
+            if (c != 0)
+                return c < 0;
+        }
+        return a.length < b.length;
+    }
+
+private:
+    static uint32_t load_be32(const uint8_t *p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return __builtin_bswap32(value);
+    }
+
+    static uint64_t load_be64(const uint8_t *p)
+    {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return __builtin_bswap64(value);
+    }
+
+    VarKeyView _keys;
+};
@@ -0,0 +1,319 @@
+#include "algorithms/adaptive_sort.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <pdqsort.h>
+
+#include "key_compare.hpp"
+#include "key_prefix.hpp"
+#include "algorithms/radix.hpp"
+#include "algorithms/prefix.hpp"
+#include "algorithms/samplesort.hpp"
+#include "algorithms/count_sort.hpp"
+
+namespace
+{
+    // Consecutive RowIDs per sampled run; adjacent pairs within a run measure presortedness
+    constexpr size_t SAMPLE_RUN = 16;
+
+    // Inputs up to this size are sorted with pdqsort without sampling
+    constexpr size_t SMALL_INPUT = 1024;
+
+    // Bits of first-byte entropy below which the top-byte buckets of the prefix sort are too few or too skewed to
+    // keep the threads busy; 4 bits are 16 equally likely values
+    constexpr double PREFIX_MIN_ENTROPY = 4.0;
+
+    // Smaller inputs get smaller samples, so that sampling stays a small fraction of the sort
+    size_t sample_size_for(size_t n)
+    {
+        return std::min(SORT_SAMPLE_SIZE, std::max(SAMPLE_RUN, n / 16));
+    }
+
+    void pdqsort_rowids(const KeyView &keys, std::vector<RowID> &rowids)
+    {
+        dispatch_key_size(keys.key_size(), [&](auto key_size)
+                          {
+            const KeyLess<decltype(key_size)::value> less(keys.key_size());
+            pdqsort(rowids.begin(), rowids.end(),
+                    [&](const RowID &a, const RowID &b)
+                    { return less(keys[row_index(a)], keys[row_index(b)]); }); });
+    }
+
+    // Checks in one parallel pass whether the RowIDs are in ascending or descending key order. Ascending input is
+    // left alone, descending input is reversed. Returns false, without changes, if it is neither.
+    bool sort_presorted(const KeyView &keys, std::vector<RowID> &rowids, const ExecutionContext &ctx)
+    {
+        const size_t n = rowids.size();
+        const size_t parts = num_parallel_parts(ctx, n);
+        std::vector<uint8_t> ascending(parts), descending(parts);
+        dispatch_key_size(keys.key_size(), [&](auto key_size)
+                          {
+            const KeyLess<decltype(key_size)::value> less(keys.key_size());
+            parallel_for(ctx, parts, [&](size_t p)
+                         {
+                // Every part also checks the pair that straddles its end
+                const size_t begin = p * n / parts;
+                const size_t end = std::min(n - 1, (p + 1) * n / parts);
+                bool asc = true, desc = true;
+                for (size_t i = begin; i < end && (asc || desc); ++i)
+                {
+                    const uint8_t *a = keys[row_index(rowids[i])];
+                    const uint8_t *b = keys[row_index(rowids[i + 1])];
+                    asc = asc && !less(b, a);
+                    desc = desc && !less(a, b);
+                }
+                ascending[p] = asc;
+                descending[p] = desc; }); });
+
+        const auto all = [](const std::vector<uint8_t> &flags)
+        { return std::all_of(flags.begin(), flags.end(), [](uint8_t flag)
+                             { return flag != 0; }); };
+        if (all(ascending))
+            return true;
+        if (!all(descending))
+            return false;
+        std::reverse(rowids.begin(), rowids.end());
+        return true;
+    }
+
+    const SortDecision &log_decision(const SortDecision &decision)
+    {
+        if (SORT_LOG)
+            std::clog << "sort_rowids: " << decision << std::endl;
+        return decision;
+    }
+
+    // Runs one of the engines that always sort
+    void run_engine(
+        SortEngine engine,
+        const KeyView &keys,
+        std::vector<RowID> &rowids,
+        const ExecutionContext &ctx,
+        TieBreak tie_break)
+    {
+        switch (engine)
+        {
+        case SortEngine::Pdqsort:
+            pdqsort_rowids(keys, rowids);
+            if (tie_break == TieBreak::RowID)
+                order_ties_by_rowid(keys, rowids, ctx);
+            break;
+        case SortEngine::Radix:
+            hybrid_radix_sort_rowids_msb(keys, rowids, ctx, MSD_RADIX_CUTOFF, tie_break);
+            break;
+        case SortEngine::Prefix:
+            prefix_sort_rowids(keys, rowids, ctx, tie_break);
+            break;
+        case SortEngine::Samplesort:
+            samplesort_rowids(keys, rowids, ctx, tie_break);
+            break;
+        case SortEngine::Presorted:
+        case SortEngine::Count:
+            break;
+        }
+    }
+}
+
+const char *sort_engine_name(SortEngine engine)
+{
+    switch (engine)
+    {
+    case SortEngine::Pdqsort:
+        return "pdqsort";
+    case SortEngine::Presorted:
+        return "presorted";
+    case SortEngine::Radix:
+        return "radix";
+    case SortEngine::Prefix:
+        return "prefix";
+    case SortEngine::Samplesort:
+        return "samplesort";
+    case SortEngine::Count:
+        return "count";
+    }
+    return "unknown";
+}
+
+std::ostream &operator<<(std::ostream &out, const SortDecision &decision)
+{
+    const InputStats &stats = decision.stats;
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << std::fixed << std::setprecision(2)
+        << "engine=" << sort_engine_name(decision.engine) << " threads=" << decision.num_threads
+        << " | rows=" << stats.num_rows << " key_size=" << stats.key_size << " sample=" << stats.sample_size
+        << " first_byte_entropy=" << stats.first_byte_entropy << " common_prefix=" << stats.common_prefix
+        << " distinct=" << stats.sample_distinct << " distinct_prefixes=" << stats.sample_distinct_prefixes
+        << " distinct_estimate=" << stats.distinct_estimate << " ascending=" << stats.ascending_fraction
+        << " descending=" << stats.descending_fraction;
+    out.flags(flags);
+    out.precision(precision);
+    return out;
+}
+
+InputStats sample_input(
+    const KeyView &keys,
+    const std::vector<RowID> &rowids,
+    size_t sample_size)
+{
+    InputStats stats;
+    const size_t n = rowids.size();
+    const size_t key_size = keys.key_size();
+    stats.num_rows = n;
+    stats.key_size = key_size;
+    if (n == 0 || sample_size == 0)
+        return stats;
+
+    // 1) Short runs of consecutive RowIDs spread evenly over the input; small inputs are taken whole
+    const size_t num_runs = n <= sample_size ? 1 : std::max<size_t>(1, sample_size / SAMPLE_RUN);
+    const size_t run_length = n <= sample_size ? n : std::min(SAMPLE_RUN, n / num_runs);
+    std::vector<const uint8_t *> sample;
+    sample.reserve(num_runs * run_length);
+    size_t pairs = 0, ascending = 0, descending = 0;
+    for (size_t r = 0; r < num_runs; ++r)
+    {
+        const size_t begin = r * n / num_runs;
+        for (size_t i = begin; i < begin + run_length; ++i)
+        {
+            const uint8_t *key = keys[row_index(rowids[i])];
+            if (i > begin)
+            {
+                const int c = std::memcmp(sample.back(), key, key_size);
+                ++pairs;
+                ascending += c <= 0;
+                descending += c >= 0;
+            }
+            sample.push_back(key);
+        }
+    }
+    const size_t s = sample.size();
+    stats.sample_size = s;
+    stats.ascending_fraction = pairs > 0 ? double(ascending) / pairs : 1.0;
+    stats.descending_fraction = pairs > 0 ? double(descending) / pairs : 1.0;
+
+    // 2) Entropy of the first byte
+    if (key_size > 0)
+    {
+        std::array<size_t, 256> histogram = {};
+        for (const uint8_t *key : sample)
+            histogram[key[0]]++;
+        double entropy = 0;
+        for (size_t count : histogram)
+        {
+            if (count > 0)
+            {
+                const double p = double(count) / s;
+                entropy -= p * std::log2(p);
+            }
+        }
+        stats.first_byte_entropy = entropy;
+    }
+
+    // 3) Distinct keys and prefixes from the sorted sample; the common prefix is that of its smallest and largest key
+    std::sort(sample.begin(), sample.end(), [&](const uint8_t *a, const uint8_t *b)
+              { return std::memcmp(a, b, key_size) < 0; });
+    stats.common_prefix = std::mismatch(sample.front(), sample.front() + key_size, sample.back()).first - sample.front();
+    size_t distinct = 1, distinct_prefixes = 1, singletons = 0, group = 1;
+    for (size_t i = 1; i <= s; ++i)
+    {
+        if (i < s && std::memcmp(sample[i - 1], sample[i], key_size) == 0)
+        {
+            ++group;
+            continue;
+        }
+        singletons += group == 1;
+        group = 1;
+        if (i < s)
+        {
+            ++distinct;
+            distinct_prefixes += load_key_prefix(sample[i - 1], key_size) != load_key_prefix(sample[i], key_size);
+        }
+    }
+    stats.sample_distinct = distinct;
+    stats.sample_distinct_prefixes = distinct_prefixes;
+
+    // Guaranteed-error estimator: keys seen once in the sample stand for sqrt(n / s) keys each, repeated ones for
+    // themselves. A sample without any repeats says nothing about the duplicates, so it counts as all distinct.
+    const double estimate = std::sqrt(double(n) / s) * singletons + (distinct - singletons);
+    stats.distinct_estimate = distinct == s ? n : std::clamp<size_t>(static_cast<size_t>(estimate), distinct, n);
+    return stats;
+}
+
+SortDecision choose_sort(const InputStats &stats, const ExecutionContext &ctx)
+{
+    SortDecision decision;
+    decision.stats = stats;
+    decision.num_threads = num_parallel_parts(ctx, stats.num_rows);
+
+    if (stats.num_rows <= SMALL_INPUT)
+    {
+        decision.engine = SortEngine::Pdqsort;
+        decision.num_threads = 1;
+    }
+    else if (stats.ascending_fraction == 1.0 || stats.descending_fraction == 1.0)
+        decision.engine = SortEngine::Presorted;
+    else if (stats.num_rows <= MIN_ROWS_PER_PART)
+        decision.engine = SortEngine::Radix;
+    else if (stats.sample_distinct < stats.sample_size && stats.distinct_estimate <= COUNT_SORT_MAX_DISTINCT)
+        decision.engine = SortEngine::Count;
+    else if (stats.sample_distinct * 8 <= stats.sample_size)
+        decision.engine = SortEngine::Samplesort;
+    // Prefix sort fans out over the first key byte, so it only gets the first byte when that is well spread but
+    // not uniform, where radix is as good
+    else if (stats.common_prefix == 0 && stats.first_byte_entropy >= PREFIX_MIN_ENTROPY &&
+             stats.first_byte_entropy < 7.0 && stats.sample_distinct_prefixes * 16 >= stats.sample_distinct * 15)
+        decision.engine = SortEngine::Prefix;
+    else
+        decision.engine = SortEngine::Radix;
+    return decision;
+}
+
+SortDecision sort_rowids(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    std::vector<size_t> *group_starts,
+    TieBreak tie_break)
+{
+    const InputStats stats = rowids.size() <= SMALL_INPUT ? InputStats{rowids.size(), keys.key_size()}
+                                                          : sample_input(keys, rowids, sample_size_for(rowids.size()));
+    SortDecision decision = choose_sort(stats, ctx);
+
+    // Keep the caller's context when the decision does not cap it further
+    const ExecutionContext capped(ctx.scheduler(), decision.num_threads);
+    const ExecutionContext &sort_ctx = decision.num_threads < ctx.num_threads() ? capped : ctx;
+
+    // Presorted and Count may find out that they do not fit after all; the choice is then made again without them
+    InputStats remaining = stats;
+    if (decision.engine == SortEngine::Presorted)
+    {
+        if (sort_presorted(keys, rowids, sort_ctx))
+        {
+            if (group_starts != nullptr)
+                *group_starts = find_key_groups(keys, rowids, sort_ctx);
+            // Reversing a descending input also reverses its ties
+            if (tie_break == TieBreak::RowID)
+                order_ties_by_rowid(keys, rowids, sort_ctx, group_starts);
+            return log_decision(decision);
+        }
+        // The sample missed the disorder
+        remaining.ascending_fraction = remaining.descending_fraction = 0;
+        decision.engine = choose_sort(remaining, ctx).engine;
+    }
+    if (decision.engine == SortEngine::Count)
+    {
+        if (count_sort_rowids(keys, rowids, sort_ctx, COUNT_SORT_MAX_DISTINCT, group_starts, tie_break))
+            return log_decision(decision);
+        // The sample underestimated the distinct keys
+        remaining.distinct_estimate = SIZE_MAX;
+        decision.engine = choose_sort(remaining, ctx).engine;
+    }
+    run_engine(decision.engine, keys, rowids, sort_ctx, tie_break);
+    if (group_starts != nullptr)
+        *group_starts = find_key_groups(keys, rowids, sort_ctx);
+    return log_decision(decision);
+}
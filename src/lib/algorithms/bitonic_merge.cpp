@@ -0,0 +1,343 @@
+#include "algorithms/bitonic_merge.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include "simd_isa.hpp"
+
+namespace
+{
+    constexpr uint64_t MAX_PREFIX = std::numeric_limits<uint64_t>::max();
+
+    // Read position in one input run. The last partial block is copied into a buffer padded with maximal
+    // prefixes, so the kernels only ever load full registers.
+    template <size_t W>
+    struct RunCursor
+    {
+        const uint64_t *prefixes;
+        const uint32_t *indices;
+        size_t remaining;
+        uint64_t padded_prefixes[W];
+        uint32_t padded_indices[W];
+
+        bool exhausted() const { return remaining == 0; }
+
+        uint64_t head() const { return prefixes[0]; }
+
+        void next_block(const uint64_t *&block_prefixes, const uint32_t *&block_indices)
+        {
+            if (remaining < W)
+            {
+                std::copy(prefixes, prefixes + remaining, padded_prefixes);
+                std::copy(indices, indices + remaining, padded_indices);
+                std::fill(padded_prefixes + remaining, padded_prefixes + W, MAX_PREFIX);
+                std::fill(padded_indices + remaining, padded_indices + W, 0);
+                prefixes = padded_prefixes;
+                indices = padded_indices;
+                remaining = W;
+            }
+            block_prefixes = prefixes;
+            block_indices = indices;
+            prefixes += W;
+            indices += W;
+            remaining -= W;
+        }
+    };
+
+    // The next block always comes from the run with the smaller head, so everything emitted before it is final
+    template <size_t W>
+    RunCursor<W> &next_run(RunCursor<W> &a, RunCursor<W> &b)
+    {
+        if (b.exhausted() || (!a.exhausted() && a.head() <= b.head()))
+            return a;
+        return b;
+    }
+
+    // Write position in the output; whatever is emitted past na + nb is padding and dropped
+    struct OutputCursor
+    {
+        uint64_t *prefixes;
+        uint32_t *indices;
+        size_t remaining;
+
+        void append(const uint64_t *block_prefixes, const uint32_t *block_indices, size_t count)
+        {
+            count = std::min(count, remaining);
+            std::copy(block_prefixes, block_prefixes + count, prefixes);
+            std::copy(block_indices, block_indices + count, indices);
+            prefixes += count;
+            indices += count;
+            remaining -= count;
+        }
+    };
+
+    // Real prefixes equal to the padding prefix can be sorted behind padding and dropped with it. They are all
+    // at the end of the output, so their indices are restored from the tails of the inputs.
+    void restore_max_prefixes(
+        const uint64_t *a_prefixes, const uint32_t *a_indices, size_t na,
+        const uint64_t *b_prefixes, const uint32_t *b_indices, size_t nb,
+        uint64_t *out_prefixes, uint32_t *out_indices)
+    {
+        size_t out = na + nb;
+        for (size_t i = na; i > 0 && a_prefixes[i - 1] == MAX_PREFIX; --i)
+        {
+            out_prefixes[--out] = MAX_PREFIX;
+            out_indices[out] = a_indices[i - 1];
+        }
+        for (size_t i = nb; i > 0 && b_prefixes[i - 1] == MAX_PREFIX; --i)
+        {
+            out_prefixes[--out] = MAX_PREFIX;
+            out_indices[out] = b_indices[i - 1];
+        }
+    }
+
+#if SORT_SIMD_X86
+    // Sorts a bitonic register ascending: compare every lane with the one j lanes away, lower lanes keep the min
+    template <int Shuffle>
+    __attribute__((target("avx2"))) inline void half_clean_avx2(__m256i &v, __m256i &vi, __m256i lower)
+    {
+        const __m256i p = _mm256_permute4x64_epi64(v, Shuffle);
+        const __m256i pi = _mm256_permute4x64_epi64(vi, Shuffle);
+        const __m256i take_partner = _mm256_blendv_epi8(cmpgt_epu64(p, v), cmpgt_epu64(v, p), lower);
+        v = _mm256_blendv_epi8(v, p, take_partner);
+        vi = _mm256_blendv_epi8(vi, pi, take_partner);
+    }
+
+    // lo and hi are ascending; afterwards lo holds the 4 smallest and hi the 4 largest elements, both ascending
+    __attribute__((target("avx2"))) inline void merge_network_avx2(__m256i &lo, __m256i &lo_idx, __m256i &hi, __m256i &hi_idx)
+    {
+        const __m256i rev = _mm256_permute4x64_epi64(hi, 0x1B);
+        const __m256i rev_idx = _mm256_permute4x64_epi64(hi_idx, 0x1B);
+        const __m256i swap = cmpgt_epu64(lo, rev);
+        hi = _mm256_blendv_epi8(rev, lo, swap);
+        hi_idx = _mm256_blendv_epi8(rev_idx, lo_idx, swap);
+        lo = _mm256_blendv_epi8(lo, rev, swap);
+        lo_idx = _mm256_blendv_epi8(lo_idx, rev_idx, swap);
+
+        const __m256i lower2 = _mm256_setr_epi64x(-1, -1, 0, 0);
+        const __m256i lower1 = _mm256_setr_epi64x(-1, 0, -1, 0);
+        half_clean_avx2<0x4E>(lo, lo_idx, lower2);
+        half_clean_avx2<0x4E>(hi, hi_idx, lower2);
+        half_clean_avx2<0xB1>(lo, lo_idx, lower1);
+        half_clean_avx2<0xB1>(hi, hi_idx, lower1);
+    }
+
+    __attribute__((target("avx2"))) inline __m256i load_indices_avx2(const uint32_t *indices)
+    {
+        return _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i *>(indices)));
+    }
+
+    __attribute__((target("avx2"))) inline void emit_avx2(OutputCursor &out, __m256i v, __m256i vi)
+    {
+        const __m128i narrow = _mm256_castsi256_si128(
+            _mm256_permutevar8x32_epi32(vi, _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7)));
+        if (out.remaining >= 4)
+        {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.prefixes), v);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out.indices), narrow);
+            out.prefixes += 4;
+            out.indices += 4;
+            out.remaining -= 4;
+            return;
+        }
+        alignas(32) uint64_t prefixes[4];
+        alignas(16) uint32_t indices[4];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(prefixes), v);
+        _mm_store_si128(reinterpret_cast<__m128i *>(indices), narrow);
+        out.append(prefixes, indices, 4);
+    }
+
+    __attribute__((target("avx512f"))) inline void half_clean_avx512(__m512i &v, __m512i &vi, __m512i partner, __mmask8 lower)
+    {
+        const __m512i p = _mm512_mask_permutexvar_epi64(v, 0xFF, partner, v);
+        const __m512i pi = _mm512_mask_permutexvar_epi64(vi, 0xFF, partner, vi);
+        const __mmask8 take_partner = static_cast<__mmask8>(
+            (lower & _mm512_cmpgt_epu64_mask(v, p)) | (~lower & _mm512_cmpgt_epu64_mask(p, v)));
+        v = _mm512_mask_blend_epi64(take_partner, v, p);
+        vi = _mm512_mask_blend_epi64(take_partner, vi, pi);
+    }
+
+    // lo and hi are ascending; afterwards lo holds the 8 smallest and hi the 8 largest elements, both ascending
+    __attribute__((target("avx512f"))) inline void merge_network_avx512(__m512i &lo, __m512i &lo_idx, __m512i &hi, __m512i &hi_idx)
+    {
+        const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+        const __m512i reverse = _mm512_set_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m512i rev = _mm512_mask_permutexvar_epi64(hi, 0xFF, reverse, hi);
+        const __m512i rev_idx = _mm512_mask_permutexvar_epi64(hi_idx, 0xFF, reverse, hi_idx);
+        const __mmask8 swap = _mm512_cmpgt_epu64_mask(lo, rev);
+        hi = _mm512_mask_blend_epi64(swap, rev, lo);
+        hi_idx = _mm512_mask_blend_epi64(swap, rev_idx, lo_idx);
+        lo = _mm512_mask_blend_epi64(swap, lo, rev);
+        lo_idx = _mm512_mask_blend_epi64(swap, lo_idx, rev_idx);
+
+        const __m512i partner4 = _mm512_xor_si512(lane, _mm512_set1_epi64(4));
+        const __m512i partner2 = _mm512_xor_si512(lane, _mm512_set1_epi64(2));
+        const __m512i partner1 = _mm512_xor_si512(lane, _mm512_set1_epi64(1));
+        half_clean_avx512(lo, lo_idx, partner4, 0x0F);
+        half_clean_avx512(hi, hi_idx, partner4, 0x0F);
+        half_clean_avx512(lo, lo_idx, partner2, 0x33);
+        half_clean_avx512(hi, hi_idx, partner2, 0x33);
+        half_clean_avx512(lo, lo_idx, partner1, 0x55);
+        half_clean_avx512(hi, hi_idx, partner1, 0x55);
+    }
+
+    __attribute__((target("avx512f"))) inline __m512i load_indices_avx512(const uint32_t *indices)
+    {
+        return _mm512_maskz_cvtepu32_epi64(0xFF, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indices)));
+    }
+
+    __attribute__((target("avx512f"))) inline void emit_avx512(OutputCursor &out, __m512i v, __m512i vi)
+    {
+        const __m256i narrow = _mm512_mask_cvtepi64_epi32(_mm256_setzero_si256(), 0xFF, vi);
+        if (out.remaining >= 8)
+        {
+            _mm512_storeu_si512(out.prefixes, v);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.indices), narrow);
+            out.prefixes += 8;
+            out.indices += 8;
+            out.remaining -= 8;
+            return;
+        }
+        alignas(64) uint64_t prefixes[8];
+        alignas(32) uint32_t indices[8];
+        _mm512_store_si512(prefixes, v);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(indices), narrow);
+        out.append(prefixes, indices, 8);
+    }
+#endif
+
+    // Copies the other run when one of them is empty; returns whether there was nothing left to merge
+    bool merge_trivial(
+        const uint64_t *a_prefixes, const uint32_t *a_indices, size_t na,
+        const uint64_t *b_prefixes, const uint32_t *b_indices, size_t nb,
+        uint64_t *out_prefixes, uint32_t *out_indices)
+    {
+        if (na != 0 && nb != 0)
+            return false;
+        std::copy(a_prefixes, a_prefixes + na, out_prefixes);
+        std::copy(a_indices, a_indices + na, out_indices);
+        std::copy(b_prefixes, b_prefixes + nb, out_prefixes + na);
+        std::copy(b_indices, b_indices + nb, out_indices + na);
+        return true;
+    }
+}
+
+void merge_scalar(
+    const uint64_t *a_prefixes, const uint32_t *a_indices, size_t na,
+    const uint64_t *b_prefixes, const uint32_t *b_indices, size_t nb,
+    uint64_t *out_prefixes, uint32_t *out_indices)
+{
+    size_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb)
+    {
+        // Both candidates are loaded and the winner is selected without a branch on the comparison
+        const bool take_b = b_prefixes[j] < a_prefixes[i];
+        out_prefixes[k] = take_b ? b_prefixes[j] : a_prefixes[i];
+        out_indices[k] = take_b ? b_indices[j] : a_indices[i];
+        ++k;
+        j += take_b;
+        i += !take_b;
+    }
+    std::copy(a_prefixes + i, a_prefixes + na, out_prefixes + k);
+    std::copy(a_indices + i, a_indices + na, out_indices + k);
+    k += na - i;
+    std::copy(b_prefixes + j, b_prefixes + nb, out_prefixes + k);
+    std::copy(b_indices + j, b_indices + nb, out_indices + k);
+}
+
+#if SORT_SIMD_X86
+__attribute__((target("avx2"))) void bitonic_merge_avx2(
+    const uint64_t *a_prefixes, const uint32_t *a_indices, size_t na,
+    const uint64_t *b_prefixes, const uint32_t *b_indices, size_t nb,
+    uint64_t *out_prefixes, uint32_t *out_indices)
+{
+    if (merge_trivial(a_prefixes, a_indices, na, b_prefixes, b_indices, nb, out_prefixes, out_indices))
+        return;
+
+    RunCursor<4> a{a_prefixes, a_indices, na, {}, {}};
+    RunCursor<4> b{b_prefixes, b_indices, nb, {}, {}};
+    OutputCursor out{out_prefixes, out_indices, na + nb};
+    const uint64_t *block;
+    const uint32_t *block_indices;
+
+    next_run(a, b).next_block(block, block_indices);
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+    __m256i hi_idx = load_indices_avx2(block_indices);
+    while (!a.exhausted() || !b.exhausted())
+    {
+        next_run(a, b).next_block(block, block_indices);
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+        __m256i lo_idx = load_indices_avx2(block_indices);
+        merge_network_avx2(lo, lo_idx, hi, hi_idx);
+        emit_avx2(out, lo, lo_idx);
+    }
+    emit_avx2(out, hi, hi_idx);
+
+    restore_max_prefixes(a_prefixes, a_indices, na, b_prefixes, b_indices, nb, out_prefixes, out_indices);
+}
+
+__attribute__((target("avx512f"))) void bitonic_merge_avx512(
+    const uint64_t *a_prefixes, const uint32_t *a_indices, size_t na,
+    const uint64_t *b_prefixes, const uint32_t *b_indices, size_t nb,
+    uint64_t *out_prefixes, uint32_t *out_indices)
+{
+    if (merge_trivial(a_prefixes, a_indices, na, b_prefixes, b_indices, nb, out_prefixes, out_indices))
+        return;
+
+    RunCursor<8> a{a_prefixes, a_indices, na, {}, {}};
+    RunCursor<8> b{b_prefixes, b_indices, nb, {}, {}};
+    OutputCursor out{out_prefixes, out_indices, na + nb};
+    const uint64_t *block;
+    const uint32_t *block_indices;
+
+    next_run(a, b).next_block(block, block_indices);
+    __m512i hi = _mm512_loadu_si512(block);
+    __m512i hi_idx = load_indices_avx512(block_indices);
+    while (!a.exhausted() || !b.exhausted())
+    {
+        next_run(a, b).next_block(block, block_indices);
+        __m512i lo = _mm512_loadu_si512(block);
+        __m512i lo_idx = load_indices_avx512(block_indices);
+        merge_network_avx512(lo, lo_idx, hi, hi_idx);
+        emit_avx512(out, lo, lo_idx);
+    }
+    emit_avx512(out, hi, hi_idx);
+
+    restore_max_prefixes(a_prefixes, a_indices, na, b_prefixes, b_indices, nb, out_prefixes, out_indices);
+}
+#else
+void bitonic_merge_avx2(
+    const uint64_t *a_prefixes, const uint32_t *a_indices, size_t na,
+    const uint64_t *b_prefixes, const uint32_t *b_indices, size_t nb,
+    uint64_t *out_prefixes, uint32_t *out_indices)
+{
+    merge_scalar(a_prefixes, a_indices, na, b_prefixes, b_indices, nb, out_prefixes, out_indices);
+}
+
+void bitonic_merge_avx512(
+    const uint64_t *a_prefixes, const uint32_t *a_indices, size_t na,
+    const uint64_t *b_prefixes, const uint32_t *b_indices, size_t nb,
+    uint64_t *out_prefixes, uint32_t *out_indices)
+{
+    merge_scalar(a_prefixes, a_indices, na, b_prefixes, b_indices, nb, out_prefixes, out_indices);
+}
+#endif
+
+void bitonic_merge(
+    const uint64_t *a_prefixes, const uint32_t *a_indices, size_t na,
+    const uint64_t *b_prefixes, const uint32_t *b_indices, size_t nb,
+    uint64_t *out_prefixes, uint32_t *out_indices)
+{
+    switch (simd_isa())
+    {
+    case SimdIsa::Avx512:
+        bitonic_merge_avx512(a_prefixes, a_indices, na, b_prefixes, b_indices, nb, out_prefixes, out_indices);
+        break;
+    case SimdIsa::Avx2:
+        bitonic_merge_avx2(a_prefixes, a_indices, na, b_prefixes, b_indices, nb, out_prefixes, out_indices);
+        break;
+    default:
+        merge_scalar(a_prefixes, a_indices, na, b_prefixes, b_indices, nb, out_prefixes, out_indices);
+        break;
+    }
+}
@@ -0,0 +1,258 @@
+#include "algorithms/count_sort.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <pdqsort.h>
+
+#include "key_compare.hpp"
+#include "utils/perf_counters.hpp"
+
+namespace
+{
+    // Slots a table starts with; it doubles whenever it gets half full
+    constexpr size_t INITIAL_SLOTS = 256;
+
+    constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    uint64_t mix(uint64_t h, uint64_t word)
+    {
+        h = (h ^ word) * 0x9e3779b97f4a7c15ull;
+        return (h << 31) | (h >> 33);
+    }
+
+    // Table slots are taken from the low hash bits, so the words are folded in first and then every bit is spread
+    // over the whole hash by the murmur3 finalizer
+    uint64_t hash_key(const uint8_t *key, size_t key_size)
+    {
+        uint64_t h = key_size;
+        size_t i = 0;
+        for (; i + 8 <= key_size; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, key + i, sizeof(word));
+            h = mix(h, word);
+        }
+        if (i < key_size)
+        {
+            uint64_t word = 0;
+            std::memcpy(&word, key + i, key_size - i);
+            h = mix(h, word);
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        return h ^ (h >> 33);
+    }
+
+    // Open-addressing hash table of distinct keys. Entries are numbered in insertion order and remember the row of
+    // their first occurrence and how often they were seen.
+    class DistinctKeys
+    {
+    public:
+        struct Entry
+        {
+            uint64_t hash;
+            size_t row;
+            size_t count;
+        };
+
+        DistinctKeys(const KeyView &keys, size_t max_distinct)
+            : _keys(keys), _max_distinct(max_distinct), _slots(INITIAL_SLOTS, EMPTY_SLOT) {}
+
+        // Entry number of the key of the given row, inserted if new; EMPTY_SLOT if that would exceed max_distinct
+        uint32_t insert(size_t row, uint64_t hash)
+        {
+            const uint8_t *key = _keys[row];
+            const size_t mask = _slots.size() - 1;
+            for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+            {
+                const uint32_t id = _slots[slot];
+                if (id == EMPTY_SLOT)
+                {
+                    if (_entries.size() >= _max_distinct)
+                        return EMPTY_SLOT;
+                    const uint32_t new_id = static_cast<uint32_t>(_entries.size());
+                    _entries.push_back({hash, row, 0});
+                    _slots[slot] = new_id;
+                    if (_entries.size() * 2 > _slots.size())
+                        grow();
+                    return new_id;
+                }
+                const Entry &entry = _entries[id];
+                if (entry.hash == hash && std::memcmp(_keys[entry.row], key, _keys.key_size()) == 0)
+                    return id;
+            }
+        }
+
+        std::vector<Entry> &entries() { return _entries; }
+
+    private:
+        void grow()
+        {
+            _slots.assign(_slots.size() * 2, EMPTY_SLOT);
+            const size_t mask = _slots.size() - 1;
+            for (uint32_t id = 0; id < _entries.size(); ++id)
+            {
+                size_t slot = _entries[id].hash & mask;
+                while (_slots[slot] != EMPTY_SLOT)
+                    slot = (slot + 1) & mask;
+                _slots[slot] = id;
+            }
+        }
+
+        KeyView _keys;
+        size_t _max_distinct;
+        std::vector<uint32_t> _slots;
+        std::vector<Entry> _entries;
+    };
+}
+
+bool count_sort_rowids(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    size_t max_distinct,
+    std::vector<size_t> *group_starts,
+    TieBreak tie_break)
+{
+    const size_t n = rowids.size();
+    const size_t key_size = keys.key_size();
+    const size_t parts = num_parallel_parts(ctx, n);
+    auto part_begin = [&](size_t p)
+    { return p * n / parts; };
+
+    // 1) Every part counts the distinct keys of its rows and remembers each row's entry
+    std::vector<DistinctKeys> tables(parts, DistinctKeys(keys, max_distinct));
+    std::vector<uint32_t> entry_of(n);
+    std::atomic<bool> too_many{false};
+    parallel_for(ctx, parts, [&](size_t p)
+                 {
+        const PerfPhase phase("histogram");
+        DistinctKeys &table = tables[p];
+        const size_t end = part_begin(p + 1);
+        for (size_t i = part_begin(p); i < end; ++i)
+        {
+            const size_t row = row_index(rowids[i]);
+            const uint32_t id = table.insert(row, hash_key(keys[row], key_size));
+            if (id == EMPTY_SLOT)
+            {
+                too_many.store(true, std::memory_order_relaxed);
+                return;
+            }
+            table.entries()[id].count++;
+            entry_of[i] = id;
+            // Check now and then whether another part already gave up
+            if ((i & 0xFFF) == 0 && too_many.load(std::memory_order_relaxed))
+                return;
+        } });
+    if (too_many.load())
+        return false;
+
+    // 2) Merge the per-part tables and sort only the distinct keys
+    DistinctKeys all(keys, max_distinct);
+    std::vector<std::vector<uint32_t>> global_id(parts);
+    for (size_t p = 0; p < parts; ++p)
+    {
+        for (const auto &entry : tables[p].entries())
+        {
+            const uint32_t id = all.insert(entry.row, entry.hash);
+            if (id == EMPTY_SLOT)
+                return false;
+            global_id[p].push_back(id);
+        }
+    }
+    const auto &distinct = all.entries();
+    const size_t num_groups = distinct.size();
+    std::vector<uint32_t> order(num_groups);
+    for (uint32_t g = 0; g < num_groups; ++g)
+        order[g] = g;
+    dispatch_key_size(key_size, [&](auto width)
+                      {
+        const PerfPhase phase("leaf sort");
+        const KeyLess<decltype(width)::value> less(key_size);
+        pdqsort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+                { return less(keys[distinct[a].row], keys[distinct[b].row]); }); });
+    std::vector<uint32_t> rank(num_groups);
+    for (uint32_t r = 0; r < num_groups; ++r)
+        rank[order[r]] = r;
+
+    // 3) A prefix sum in (group, part) order gives every part disjoint output slots per group
+    std::vector<std::vector<size_t>> offsets(parts, std::vector<size_t>(num_groups, 0));
+    std::vector<std::vector<uint32_t>> local_rank(parts);
+    for (size_t p = 0; p < parts; ++p)
+    {
+        const auto &entries = tables[p].entries();
+        local_rank[p].resize(entries.size());
+        for (size_t id = 0; id < entries.size(); ++id)
+        {
+            local_rank[p][id] = rank[global_id[p][id]];
+            offsets[p][local_rank[p][id]] = entries[id].count;
+        }
+    }
+    // The tie-break needs the groups even if the caller does not
+    std::vector<size_t> local_starts;
+    if (group_starts == nullptr && tie_break == TieBreak::RowID)
+        group_starts = &local_starts;
+    if (group_starts != nullptr)
+        group_starts->resize(num_groups + 1);
+    size_t sum = 0;
+    for (size_t r = 0; r < num_groups; ++r)
+    {
+        if (group_starts != nullptr)
+            (*group_starts)[r] = sum;
+        for (size_t p = 0; p < parts; ++p)
+        {
+            const size_t count = offsets[p][r];
+            offsets[p][r] = sum;
+            sum += count;
+        }
+    }
+    if (group_starts != nullptr)
+        (*group_starts)[num_groups] = n;
+
+    // 4) Scatter every part's RowIDs into its slots of their groups
+    std::vector<RowID> sorted(n);
+    parallel_for(ctx, parts, [&](size_t p)
+                 {
+        const PerfPhase phase("scatter");
+        auto &fill = offsets[p];
+        const auto &ranks = local_rank[p];
+        const size_t end = part_begin(p + 1);
+        for (size_t i = part_begin(p); i < end; ++i)
+            sorted[fill[ranks[entry_of[i]]]++] = rowids[i]; });
+    rowids.swap(sorted);
+    // The scatter is stable, so this only checks each group unless the RowIDs came in unordered
+    if (tie_break == TieBreak::RowID)
+        order_ties_by_rowid(keys, rowids, ctx, group_starts);
+    return true;
+}
+
+std::vector<size_t> find_key_groups(
+    const KeyView &keys,
+    const std::vector<RowID> &rowids,
+    const ExecutionContext &ctx)
+{
+    const size_t n = rowids.size();
+    const size_t parts = num_parallel_parts(ctx, n);
+    std::vector<std::vector<size_t>> starts(parts);
+    dispatch_key_size(keys.key_size(), [&](auto width)
+                      {
+        const KeyLess<decltype(width)::value> less(keys.key_size());
+        parallel_for(ctx, parts, [&](size_t p)
+                     {
+            const size_t end = (p + 1) * n / parts;
+            for (size_t i = p * n / parts; i < end; ++i)
+            {
+                // The RowIDs are sorted, so a key that is not equal to its predecessor is larger
+                if (i == 0 || less(keys[row_index(rowids[i - 1])], keys[row_index(rowids[i])]))
+                    starts[p].push_back(i);
+            } }); });
+
+    std::vector<size_t> group_starts;
+    for (const auto &part : starts)
+        group_starts.insert(group_starts.end(), part.begin(), part.end());
+    group_starts.push_back(n);
+    return group_starts;
+}
@@ -0,0 +1,276 @@
+#include "algorithms/external_sort.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "key_compare.hpp"
+#include "key_prefix.hpp"
+#include "algorithms/radix.hpp"
+#include "algorithms/merge.hpp"
+#include "algorithms/kway_merge.hpp"
+
+namespace
+{
+    // Records converted and written per write() when a run is spilled (1 MiB), unless the limit is small
+    constexpr size_t WRITE_RECORDS = 1 << 16;
+    // Smallest read buffer of a run during the merge, spill buffer and batch
+    constexpr size_t MIN_READ_RECORDS = 1024;
+
+    [[noreturn]] void throw_errno(const char *what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    // Temporary file that is unlinked as soon as it is created and closed on destruction
+    class SpillFile
+    {
+    public:
+        SpillFile()
+        {
+            const char *dir = std::getenv("TMPDIR");
+            std::string path = std::string(dir != nullptr && *dir != '\0' ? dir : "/tmp") + "/sort-run-XXXXXX";
+            _fd = mkstemp(path.data());
+            if (_fd < 0)
+                throw_errno("external sort: cannot create spill file");
+            unlink(path.c_str());
+        }
+
+        SpillFile(SpillFile &&other) noexcept : _fd(std::exchange(other._fd, -1)) {}
+        SpillFile(const SpillFile &) = delete;
+        SpillFile &operator=(const SpillFile &) = delete;
+
+        ~SpillFile()
+        {
+            if (_fd >= 0)
+                close(_fd);
+        }
+
+        int fd() const { return _fd; }
+
+    private:
+        int _fd;
+    };
+
+    void write_all(int fd, const void *data, size_t bytes)
+    {
+        const char *p = static_cast<const char *>(data);
+        while (bytes > 0)
+        {
+            const ssize_t written = write(fd, p, bytes);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw_errno("external sort: cannot write run");
+            }
+            p += written;
+            bytes -= static_cast<size_t>(written);
+        }
+    }
+
+    void read_all(int fd, void *data, size_t bytes, off_t offset)
+    {
+        char *p = static_cast<char *>(data);
+        while (bytes > 0)
+        {
+            const ssize_t got = pread(fd, p, bytes, offset);
+            if (got < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw_errno("external sort: cannot read run");
+            }
+            if (got == 0)
+            {
+                errno = EIO;
+                throw_errno("external sort: run file is truncated");
+            }
+            p += got;
+            offset += got;
+            bytes -= static_cast<size_t>(got);
+        }
+    }
+
+    // Writes a sorted batch to fd as {prefix, RowID} records, converting WRITE_RECORDS at a time
+    void spill_run(const KeyView &keys, const std::vector<RowID> &batch, int fd, std::vector<PrefixRecord> &records)
+    {
+        const size_t key_size = keys.key_size();
+        for (size_t begin = 0; begin < batch.size(); begin += records.size())
+        {
+            const size_t end = std::min(batch.size(), begin + records.size());
+            for (size_t i = begin; i < end; ++i)
+                records[i - begin] = {load_key_prefix(keys[row_index(batch[i])], key_size), batch[i]};
+            write_all(fd, records.data(), (end - begin) * sizeof(PrefixRecord));
+        }
+    }
+
+    // Streams one spilled run back through a fixed-size buffer
+    class RunReader
+    {
+    public:
+        RunReader(int fd, size_t size, size_t capacity)
+            : _fd(fd), _remaining(size), _buffer(capacity)
+        {
+            posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            refill();
+        }
+
+        const PrefixRecord *begin() const { return _buffer.data() + _pos; }
+        const PrefixRecord *end() const { return _buffer.data() + _end; }
+        bool empty() const { return _pos == _end; }
+        bool exhausted() const { return empty() && _remaining == 0; }
+
+        void consume(size_t count) { _pos += count; }
+
+        // Loads the next stretch of the run and asks the kernel to start reading the one after it, so that the
+        // disk works on the next refill while the current buffer is merged
+        void refill()
+        {
+            const size_t count = std::min(_buffer.size(), _remaining);
+            read_all(_fd, _buffer.data(), count * sizeof(PrefixRecord), _offset);
+            _offset += static_cast<off_t>(count * sizeof(PrefixRecord));
+            _remaining -= count;
+            _pos = 0;
+            _end = count;
+            if (_remaining > 0)
+                posix_fadvise(_fd, _offset, static_cast<off_t>(std::min(_buffer.size(), _remaining) * sizeof(PrefixRecord)),
+                              POSIX_FADV_WILLNEED);
+        }
+
+    private:
+        int _fd;
+        off_t _offset = 0;
+        size_t _remaining; // records of the run not read yet
+        std::vector<PrefixRecord> _buffer;
+        size_t _pos = 0;
+        size_t _end = 0;
+    };
+
+    /**
+     * Merges the spilled runs into rowids. Every step emits all buffered records up to the smallest buffered
+     * tail, which no record still on disk can precede, with one parallel k-way merge; at least the run that
+     * owns that tail is used up and refilled.
+     */
+    template <size_t TailSize>
+    void merge_runs(
+        const KeyView &keys,
+        std::vector<RowID> &rowids,
+        const ExecutionContext &ctx,
+        const std::vector<SpillFile> &files,
+        const std::vector<size_t> &run_sizes,
+        size_t memory_limit)
+    {
+        const size_t k = files.size();
+        const PrefixRecordLess<TailSize> cmp(keys);
+
+        // Read buffers and the merge output share the limit equally
+        const size_t capacity = std::max(memory_limit / (2 * k * sizeof(PrefixRecord)), MIN_READ_RECORDS);
+        std::vector<RunReader> readers;
+        readers.reserve(k);
+        for (size_t i = 0; i < k; ++i)
+            readers.emplace_back(files[i].fd(), run_sizes[i], capacity);
+        std::vector<PrefixRecord> merged(k * capacity);
+        std::vector<MergeRun<PrefixRecord>> windows(k);
+        std::vector<size_t> to_refill;
+
+        for (size_t out = 0; out < rowids.size();)
+        {
+            const PrefixRecord *bound = nullptr;
+            for (const auto &reader : readers)
+            {
+                if (!reader.empty() && (bound == nullptr || cmp(reader.end()[-1], *bound)))
+                    bound = reader.end() - 1;
+            }
+            size_t total = 0;
+            for (size_t i = 0; i < k; ++i)
+            {
+                windows[i] = {readers[i].begin(), std::upper_bound(readers[i].begin(), readers[i].end(), *bound, cmp)};
+                total += windows[i].size();
+            }
+            parallel_kway_merge(ctx, windows, merged.data(), cmp);
+            for (size_t i = 0; i < total; ++i)
+                rowids[out + i] = merged[i].rowid;
+            out += total;
+
+            to_refill.clear();
+            for (size_t i = 0; i < k; ++i)
+            {
+                readers[i].consume(windows[i].size());
+                if (readers[i].empty() && !readers[i].exhausted())
+                    to_refill.push_back(i);
+            }
+            parallel_for(ctx, to_refill.size(), [&](size_t i)
+                         { readers[to_refill[i]].refill(); });
+        }
+    }
+}
+
+size_t external_sort_rowids(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    size_t memory_limit,
+    RunSortEngine engine,
+    TieBreak tie_break)
+{
+    const size_t n = rowids.size();
+    if (n <= 1)
+        return 0;
+
+    // Batch copy plus the engine's own buffers; sorting rowids directly only needs the latter
+    const size_t bytes_per_row = engine == RunSortEngine::Radix ? 2 * sizeof(RowID) + 1 : 2 * sizeof(RowID);
+    std::vector<RowID> scratch;
+    auto sort_batch = [&](std::vector<RowID> &batch)
+    {
+        if (engine == RunSortEngine::Radix)
+            hybrid_radix_sort_rowids_msb(keys, batch, ctx, MSD_RADIX_CUTOFF, tie_break);
+        else
+            merge_sort(keys, batch, ctx, MergeStrategy::KWay, &scratch, tie_break);
+    };
+
+    if (memory_limit == 0 || n * (bytes_per_row - sizeof(RowID)) <= memory_limit)
+    {
+        sort_batch(rowids);
+        return 0;
+    }
+
+    // 1) Sort batches that fit into the limit next to the write buffer and spill them as runs. The write buffer
+    //    takes at most a quarter of the limit; batches are chunk-aligned when at least one chunk fits.
+    const size_t write_records = std::clamp(memory_limit / 4 / sizeof(PrefixRecord), MIN_READ_RECORDS, WRITE_RECORDS);
+    const size_t write_buffer = write_records * sizeof(PrefixRecord);
+    const size_t fitting_rows = memory_limit > write_buffer ? (memory_limit - write_buffer) / bytes_per_row : 0;
+    const size_t batch_rows = fitting_rows >= CHUNK_SIZE ? fitting_rows / CHUNK_SIZE * CHUNK_SIZE
+                                                         : std::max(fitting_rows, MIN_READ_RECORDS);
+
+    std::vector<SpillFile> files;
+    std::vector<size_t> run_sizes;
+    {
+        std::vector<RowID> batch;
+        std::vector<PrefixRecord> records(write_records);
+        for (size_t begin = 0; begin < n; begin += batch_rows)
+        {
+            const size_t end = std::min(n, begin + batch_rows);
+            batch.assign(rowids.begin() + begin, rowids.begin() + end);
+            sort_batch(batch);
+            files.emplace_back();
+            spill_run(keys, batch, files.back().fd(), records);
+            run_sizes.push_back(end - begin);
+        }
+        // Hand the batch memory back before the merge allocates its buffers
+        std::vector<RowID>().swap(scratch);
+    }
+
+    // 2) Stream the runs back through one k-way merge
+    dispatch_key_size(prefix_tail_size(keys.key_size()), [&](auto tail)
+                      { merge_runs<decltype(tail)::value>(keys, rowids, ctx, files, run_sizes, memory_limit); });
+    // Equal keys from different runs come out of the merge in any order
+    if (tie_break == TieBreak::RowID)
+        order_ties_by_rowid(keys, rowids, ctx);
+    return files.size();
+}
@@ -1,109 +1,262 @@
 #include <algorithm>
 #include <vector>
-#include <future>
 #include <cstring>
-#include "thread_pool.hpp"
+#include <functional>
+#include <limits>
+#include <utility>
+#include "task_scheduler.hpp"
 #include "algorithms/merge.hpp"
+#include "algorithms/merge_path.hpp"
+#include "algorithms/kway_merge.hpp"
+#include "algorithms/bitonic_merge.hpp"
 #include "rowid.hpp"
+#include "key_compare.hpp"
+#include "key_prefix.hpp"
+#include "utils/perf_counters.hpp"
 #include <pdqsort.h>
 
+template <size_t KeySize>
 struct RowIDKeyComparator
 {
-    const std::vector<ByteKey> &keys;
-    size_t key_size;
-    RowIDKeyComparator(const std::vector<ByteKey> &keys, size_t key_size)
-        : keys(keys), key_size(key_size) {}
+    KeyView keys;
+    KeyLess<KeySize> less;
+    RowIDKeyComparator(const KeyView &keys, size_t key_size)
+        : keys(keys), less(key_size) {}
     bool operator()(const RowID &a, const RowID &b) const
     {
-        const auto &key_a = keys[CHUNK_SIZE * a.chunk_id + a.chunk_offset];
-        const auto &key_b = keys[CHUNK_SIZE * b.chunk_id + b.chunk_offset];
-        return memcmp(key_a.data(), key_b.data(), key_size) < 0;
+        return less(keys[row_index(a)], keys[row_index(b)]);
     }
 };
 
-void merge_sort(
-    const std::vector<ByteKey> &keys,
-    std::vector<RowID> &rowids)
+// After a pairwise round the merged chunks keep every other boundary
+static void halve_bounds(std::vector<size_t> &bounds, size_t total)
 {
-    if (rowids.empty())
-        return;
-    const size_t key_size = keys[0].size();
-    const size_t num_threads = std::max<size_t>(2, std::thread::hardware_concurrency());
-    const size_t chunk_size = (rowids.size() + num_threads - 1) / num_threads;
-    std::vector<std::vector<RowID>> chunks;
-    chunks.reserve(num_threads);
-
-    // Split rowids into chunks (move, not copy)
-    auto it = rowids.begin();
-    for (size_t i = 0; i < num_threads && it != rowids.end(); ++i)
+    size_t kept = 0;
+    for (size_t i = 0; i < bounds.size(); i += 2)
+        bounds[kept++] = bounds[i];
+    if (bounds[kept - 1] != total)
+        bounds[kept++] = total;
+    bounds.resize(kept);
+}
+
+struct PrefixBuffer
+{
+    uint64_t *prefixes;
+    uint32_t *positions;
+};
+
+// Writes outputs [lo, hi) of the merge of src chunks [begin, mid) and [mid, end) to dst + begin + lo
+static void bitonic_merge_part(
+    const PrefixBuffer &src, const PrefixBuffer &dst, size_t begin, size_t mid, size_t end, size_t lo, size_t hi)
+{
+    const uint64_t *a = src.prefixes + begin;
+    const uint64_t *b = src.prefixes + mid;
+    const size_t a_lo = merge_path_corank(lo, a, mid - begin, b, end - mid, std::less<uint64_t>());
+    const size_t a_hi = merge_path_corank(hi, a, mid - begin, b, end - mid, std::less<uint64_t>());
+    bitonic_merge(a + a_lo, src.positions + begin + a_lo, a_hi - a_lo,
+                  b + (lo - a_lo), src.positions + mid + (lo - a_lo), (hi - a_hi) - (lo - a_lo),
+                  dst.prefixes + begin + lo, dst.positions + begin + lo);
+}
+
+// Pairwise merge rounds over {8-byte key prefix, position in rowids} pairs with the SIMD bitonic merge kernel.
+// Chunks arrive sorted on the full keys, but keys that share a prefix can interleave across chunks, so runs of
+// equal prefixes are sorted on the full keys once more before the RowIDs are gathered into their final order.
+template <size_t KeySize>
+static void merge_prefix_rounds(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    std::vector<RowID> &buffer,
+    std::vector<size_t> bounds,
+    const ExecutionContext &ctx,
+    const RowIDKeyComparator<KeySize> &cmp)
+{
+    const size_t total = rowids.size();
+    const size_t key_size = keys.key_size();
+    const size_t num_threads = bounds.size() - 1;
+
+    std::vector<uint64_t> prefixes[2] = {std::vector<uint64_t>(total), std::vector<uint64_t>(total)};
+    std::vector<uint32_t> positions[2] = {std::vector<uint32_t>(total), std::vector<uint32_t>(total)};
+    parallel_for(ctx, num_threads, [&](size_t t)
+                 {
+        const PerfPhase phase("gather");
+        for (size_t i = bounds[t]; i < bounds[t + 1]; ++i)
+        {
+            prefixes[0][i] = load_key_prefix(keys[row_index(rowids[i])], key_size);
+            positions[0][i] = static_cast<uint32_t>(i);
+        } });
+
+    PrefixBuffer src{prefixes[0].data(), positions[0].data()};
+    PrefixBuffer dst{prefixes[1].data(), positions[1].data()};
+    while (bounds.size() > 2)
     {
-        size_t this_chunk_size = std::min(chunk_size, static_cast<size_t>(rowids.end() - it));
-        std::vector<RowID> chunk;
-        chunk.reserve(this_chunk_size);
-        for (size_t j = 0; j < this_chunk_size && it != rowids.end(); ++j, ++it)
+        const size_t num_chunks = bounds.size() - 1;
+        TaskGroup group(ctx);
+        for (size_t i = 0; i + 1 < num_chunks; i += 2)
         {
-            chunk.push_back(std::move(*it));
+            const size_t begin = bounds[i];
+            const size_t mid = bounds[i + 1];
+            const size_t end = bounds[i + 2];
+            const size_t merged_size = end - begin;
+            const size_t parts = std::max<size_t>(1, (merged_size * num_threads + total - 1) / total);
+            for (size_t p = 0; p < parts; ++p)
+            {
+                const size_t lo = p * merged_size / parts;
+                const size_t hi = (p + 1) * merged_size / parts;
+                group.spawn([&src, &dst, begin, mid, end, lo, hi]
+                            {
+                    const PerfPhase phase("merge");
+                    bitonic_merge_part(src, dst, begin, mid, end, lo, hi); });
+            }
         }
-        chunks.push_back(std::move(chunk));
+        if (num_chunks % 2 == 1)
+        {
+            const size_t begin = bounds[num_chunks - 1];
+            const size_t end = bounds[num_chunks];
+            group.spawn([&src, &dst, begin, end]
+                        {
+                const PerfPhase phase("merge");
+                std::copy(src.prefixes + begin, src.prefixes + end, dst.prefixes + begin);
+                std::copy(src.positions + begin, src.positions + end, dst.positions + begin); });
+        }
+        group.sync();
+        halve_bounds(bounds, total);
+        std::swap(src, dst);
     }
-    rowids.clear();
 
-    ThreadPool pool(num_threads);
-    RowIDKeyComparator cmp(keys, key_size);
-    std::vector<std::future<void>> sort_futures;
+    // Tie-break fix-up and gather, in blocks that start at the beginning of a run of equal prefixes
+    const auto run_start = [&](size_t i)
+    {
+        while (i > 0 && i < total && src.prefixes[i] == src.prefixes[i - 1])
+            --i;
+        return i;
+    };
+    parallel_for(ctx, num_threads, [&](size_t t)
+                 {
+        const PerfPhase phase("gather");
+        const size_t begin = run_start(t * total / num_threads);
+        const size_t end = run_start((t + 1) * total / num_threads);
+        if (key_size > 8)
+        {
+            for (size_t run = begin; run < end;)
+            {
+                size_t run_end = run + 1;
+                while (run_end < end && src.prefixes[run_end] == src.prefixes[run])
+                    ++run_end;
+                if (run_end - run > 1)
+                    pdqsort(src.positions + run, src.positions + run_end,
+                            [&](uint32_t a, uint32_t b)
+                            { return cmp(rowids[a], rowids[b]); });
+                run = run_end;
+            }
+        }
+        for (size_t i = begin; i < end; ++i)
+            buffer[i] = rowids[src.positions[i]]; });
+    rowids.swap(buffer);
+}
+
+template <size_t KeySize>
+static void merge_sort_impl(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    MergeStrategy strategy,
+    std::vector<RowID> *scratch)
+{
+    const size_t total = rowids.size();
+    const size_t num_threads = std::max<size_t>(2, std::min(ctx.num_threads(), total));
+
+    // The caller's buffer and one scratch buffer of the same size are all the memory used; chunks are index ranges
+    std::vector<RowID> local_scratch;
+    std::vector<RowID> &buffer = scratch != nullptr ? *scratch : local_scratch;
+    buffer.resize(total);
+
+    // Chunk i is [bounds[i], bounds[i + 1])
+    std::vector<size_t> bounds(num_threads + 1);
+    for (size_t i = 0; i <= num_threads; ++i)
+        bounds[i] = i * total / num_threads;
+
+    RowIDKeyComparator<KeySize> cmp(keys, keys.key_size());
 
     // Sort each chunk in parallel
-    for (auto &chunk : chunks)
+    parallel_for(ctx, num_threads, [&](size_t i)
+                 {
+        const PerfPhase phase("leaf sort");
+        pdqsort(rowids.begin() + bounds[i], rowids.begin() + bounds[i + 1], cmp); });
+
+    if (strategy == MergeStrategy::KWay)
     {
-        sort_futures.push_back(pool.enqueue([&cmp, &chunk]
-                                            { pdqsort(chunk.begin(), chunk.end(), cmp); }));
+        // Every element passes through memory once instead of log2(num_threads) times
+        std::vector<MergeRun<RowID>> runs(num_threads);
+        for (size_t i = 0; i < num_threads; ++i)
+            runs[i] = {rowids.data() + bounds[i], rowids.data() + bounds[i + 1]};
+        parallel_kway_merge(ctx, runs, buffer.data(), cmp);
+        rowids.swap(buffer);
+        return;
     }
-    for (auto &fut : sort_futures)
-        fut.get();
 
-    // Merge chunks in parallel until <=2 remain
-    while (chunks.size() > 2)
+    // Positions are 32-bit; larger inputs take the pairwise RowID merge below
+    if (strategy == MergeStrategy::Bitonic && total <= std::numeric_limits<uint32_t>::max())
     {
-        std::vector<std::vector<RowID>> next_chunks;
-        std::vector<std::future<std::vector<RowID>>> merge_futures;
-        for (size_t i = 0; i + 1 < chunks.size(); i += 2)
-        {
-            auto &left = chunks[i];
-            auto &right = chunks[i + 1];
-            merge_futures.push_back(pool.enqueue([&cmp, l = std::move(left), r = std::move(right)]() mutable
-                                                 {
-                std::vector<RowID> merged;
-                merged.reserve(l.size() + r.size());
-                std::merge(std::make_move_iterator(l.begin()), std::make_move_iterator(l.end()),
-                           std::make_move_iterator(r.begin()), std::make_move_iterator(r.end()),
-                           std::back_inserter(merged), cmp);
-                return merged; }));
-        }
-        // If odd chunk out, just move it to next round
-        if (chunks.size() % 2 == 1)
+        merge_prefix_rounds(keys, rowids, buffer, bounds, ctx, cmp);
+        return;
+    }
+
+    // Merge chunks pairwise until one remains, alternating between the two buffers. Every round, including the
+    // last one, is cut into sub-merges of about total / num_threads outputs via merge path, so all threads stay
+    // busy however few pairs are left.
+    RowID *src = rowids.data();
+    RowID *dst = buffer.data();
+    while (bounds.size() > 2)
+    {
+        const size_t num_chunks = bounds.size() - 1;
+        TaskGroup group(ctx);
+        for (size_t i = 0; i + 1 < num_chunks; i += 2)
         {
-            next_chunks.push_back(std::move(chunks.back()));
+            const size_t begin = bounds[i];
+            const size_t mid = bounds[i + 1];
+            const size_t merged_size = bounds[i + 2] - begin;
+            const size_t parts = std::max<size_t>(1, (merged_size * num_threads + total - 1) / total);
+            for (size_t p = 0; p < parts; ++p)
+            {
+                group.spawn([=, &cmp]
+                            {
+                    const PerfPhase phase("merge");
+                    merge_path_range(src + begin, mid - begin, src + mid, begin + merged_size - mid,
+                                     dst + begin, p * merged_size / parts, (p + 1) * merged_size / parts, cmp); });
+            }
         }
-        // Collect merged results
-        for (auto &fut : merge_futures)
+        // If odd chunk out, carry it over to the other buffer unchanged
+        if (num_chunks % 2 == 1)
         {
-            next_chunks.push_back(fut.get());
+            const size_t begin = bounds[num_chunks - 1];
+            const size_t end = bounds[num_chunks];
+            group.spawn([=]
+                        {
+                const PerfPhase phase("merge");
+                std::copy(src + begin, src + end, dst + begin); });
         }
-        chunks = std::move(next_chunks);
-    }
+        group.sync();
 
-    // Final merge single-threaded, move semantics
-    if (chunks.size() == 2)
-    {
-        std::vector<RowID> merged;
-        merged.reserve(chunks[0].size() + chunks[1].size());
-        std::merge(std::make_move_iterator(chunks[0].begin()), std::make_move_iterator(chunks[0].end()),
-                   std::make_move_iterator(chunks[1].begin()), std::make_move_iterator(chunks[1].end()),
-                   std::back_inserter(merged), cmp);
-        rowids = std::move(merged);
-    }
-    else if (chunks.size() == 1)
-    {
-        rowids = std::move(chunks[0]);
+        halve_bounds(bounds, total);
+        std::swap(src, dst);
     }
+
+    if (src != rowids.data())
+        rowids.swap(buffer);
+}
+
+void merge_sort(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    MergeStrategy strategy,
+    std::vector<RowID> *scratch,
+    TieBreak tie_break)
+{
+    if (rowids.empty())
+        return;
+    dispatch_key_size(keys.key_size(), [&](auto key_size)
+                      { merge_sort_impl<decltype(key_size)::value>(keys, rowids, ctx, strategy, scratch); });
+    if (tie_break == TieBreak::RowID)
+        order_ties_by_rowid(keys, rowids, ctx);
 }
@@ -0,0 +1,126 @@
+#include "algorithms/prefix.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <pdqsort.h>
+
+#include "key_prefix.hpp"
+#include "key_compare.hpp"
+#include "task_scheduler.hpp"
+#include "algorithms/msd_leaves.hpp"
+#include "utils/perf_counters.hpp"
+
+namespace
+{
+    // Buckets are split on their next prefix byte while they hold more records than this and one thread's share
+    constexpr size_t PREFIX_MIN_LEAF = 1 << 14;
+
+    void sort_by_rowid(PrefixRecord *begin, PrefixRecord *end)
+    {
+        pdqsort_branchless(begin, end,
+                           [](const PrefixRecord &a, const PrefixRecord &b)
+                           { return rowid_key(a.rowid) < rowid_key(b.rowid); });
+    }
+
+    // Sorts a run of records whose prefixes are all equal by the remaining key bytes, and with by_rowid set every
+    // run of equal keys within it by RowID. Returns the number of comparisons that had to look at the full keys.
+    size_t break_ties(const KeyView &keys, PrefixRecord *begin, PrefixRecord *end, bool by_rowid)
+    {
+        size_t lookups = 0;
+        dispatch_key_size(prefix_tail_size(keys.key_size()), [&](auto tail_size)
+                          {
+            const PrefixRecordLess<decltype(tail_size)::value> less(keys);
+            pdqsort(begin, end,
+                    [&](const PrefixRecord &a, const PrefixRecord &b)
+                    {
+                        ++lookups;
+                        return less(a, b);
+                    });
+            if (!by_rowid)
+                return;
+            for (PrefixRecord *run = begin; run != end;)
+            {
+                PrefixRecord *run_end = run + 1;
+                while (run_end != end && !less(*(run_end - 1), *run_end))
+                    ++run_end;
+                if (run_end - run > 1)
+                    sort_by_rowid(run, run_end);
+                run = run_end;
+            } });
+        return lookups;
+    }
+}
+
+size_t prefix_sort_rowids(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    TieBreak tie_break)
+{
+    if (rowids.empty())
+        return 0;
+    const bool by_rowid = tie_break == TieBreak::RowID;
+    const size_t n = rowids.size();
+    const size_t key_size = keys.key_size();
+    const size_t num_threads = ctx.num_threads();
+
+    // 1) Build the dense {prefix, RowID} array in parallel
+    std::vector<PrefixRecord> records(n);
+    const size_t block = (n + num_threads - 1) / num_threads;
+    parallel_for(ctx, (n + block - 1) / block, [&](size_t t)
+                 {
+        const PerfPhase phase("gather");
+        const size_t end = std::min(n, (t + 1) * block);
+        for (size_t i = t * block; i < end; ++i)
+            records[i] = {load_key_prefix(keys[row_index(rowids[i])], key_size), rowids[i]}; });
+
+    // 2) Partition by the most significant prefix byte, and split buckets of more than one thread's share on the
+    //    next prefix bytes, so a dominant or shared leading byte does not leave one task sorting most records
+    std::vector<PrefixRecord> buckets(n);
+    PrefixRecord *const buffers[2] = {records.data(), buckets.data()};
+    const size_t max_leaf = std::max(PREFIX_MIN_LEAF, n / num_threads);
+    std::vector<LeafBucket> leaves;
+    split_oversized<RADIX>(ctx, buffers, 0, n, 0, 0, max_leaf, sizeof(uint64_t),
+                           [](const PrefixRecord &record, size_t byte_index)
+                           { return static_cast<uint8_t>(record.prefix >> (56 - 8 * byte_index)); },
+                           leaves);
+
+    // 3) Sort the leaves largest-first by prefix, then break ties on the full key and write back the RowIDs
+    std::atomic<size_t> tie_break_lookups{0};
+    TaskGroup runners(ctx);
+    sort_leaves(ctx, runners, buffers, leaves, [&](const LeafBucket &leaf, PrefixRecord *first, PrefixRecord *)
+                {
+        PrefixRecord *last = first + leaf.size;
+        {
+            const PerfPhase phase("leaf sort");
+            pdqsort_branchless(first, last,
+                               [](const PrefixRecord &x, const PrefixRecord &y)
+                               { return x.prefix < y.prefix; });
+        }
+
+        if (key_size > 8 || by_rowid)
+        {
+            const PerfPhase phase("leaf sort");
+            size_t lookups = 0;
+            for (PrefixRecord *run = first; run != last;)
+            {
+                PrefixRecord *run_end = run + 1;
+                while (run_end != last && run_end->prefix == run->prefix)
+                    ++run_end;
+                // Keys of at most 8 bytes are equal when their prefixes are
+                if (run_end - run > 1 && key_size > 8)
+                    lookups += break_ties(keys, run, run_end, by_rowid);
+                else if (run_end - run > 1)
+                    sort_by_rowid(run, run_end);
+                run = run_end;
+            }
+            tie_break_lookups += lookups;
+        }
+
+        const PerfPhase phase("gather");
+        for (size_t i = 0; i < leaf.size; ++i)
+            rowids[leaf.begin + i] = first[i].rowid; });
+
+    return tie_break_lookups;
+}
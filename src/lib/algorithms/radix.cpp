@@ -1,160 +1,302 @@
 #include "algorithms/radix.hpp"
 
-void radix_sort(std::vector<ByteKey> &keys)
-{
-    if (keys.empty())
-        return;
+#include <cstring>
 
-    const size_t key_size = keys[0].size();
-    // const size_t RADIX = 256; // byte = 0–255
+#include "key_compare.hpp"
+#include "key_prefix.hpp"
+#include "algorithms/msd_leaves.hpp"
+#include "algorithms/small_sort.hpp"
+#include "utils/perf_counters.hpp"
 
-    // Check all keys are the same size
-    for (const auto &key : keys)
+namespace
+{
+    // Key width as a constant for the specialized kernels, or read from the keys for DYNAMIC_KEY_SIZE
+    template <size_t KeySize>
+    size_t width_of(const KeyView &keys)
     {
-        if (key.size() != key_size)
-        {
-            throw std::invalid_argument("All keys must have the same length.");
-        }
+        return KeySize != DYNAMIC_KEY_SIZE ? KeySize : keys.key_size();
     }
 
-    std::vector<ByteKey> temp(keys.size());
-
-    for (int byte_index = static_cast<int>(key_size) - 1; byte_index >= 0; --byte_index)
+    template <size_t KeySize>
+    void radix_sort_impl(KeyArena &keys)
     {
-        // Counting sort buckets
-        std::array<size_t, RADIX> count = {};
-        std::array<size_t, RADIX> prefix_sum = {};
+        const size_t key_size = width_of<KeySize>(keys);
+        const size_t num_keys = keys.size();
 
-        // Count occurrences of each byte value at position byte_index
-        for (const auto &key : keys)
-        {
-            uint8_t b = key[byte_index];
-            count[b]++;
-        }
+        KeyArena temp(num_keys, key_size);
 
-        // Compute prefix sum to determine positions
-        size_t sum = 0;
-        for (size_t i = 0; i < RADIX; ++i)
+        for (size_t pass = 0; pass < key_size; ++pass)
         {
-            prefix_sum[i] = sum;
-            sum += count[i];
+            const size_t byte_index = key_size - 1 - pass;
+            const uint8_t *digits = keys.data() + byte_index;
+
+            // Counting sort on the current byte, placing keys in temp
+            partition_records<KeySize>(keys.data(), temp.data(), num_keys, key_size,
+                                       [&](size_t i)
+                                       { return digits[i * key_size]; });
+
+            // Swap buffers instead of copying back
+            keys.swap(temp);
         }
+    }
 
-        // Place keys in temp array based on current byte
-        for (const auto &key : keys)
+    template <size_t KeySize>
+    void radix_sort_parallel_msb_impl(KeyArena &keys, size_t sort_byte_index, const ExecutionContext &ctx)
+    {
+        const size_t key_size = width_of<KeySize>(keys);
+        const size_t num_keys = keys.size();
+        const size_t num_threads = ctx.num_threads();
+
+        // Step 1: Partition keys into 256 buckets by the byte at sort_byte_index
+        KeyArena partitioned(num_keys, key_size);
+        const uint8_t *digits = keys.data() + sort_byte_index;
+        const PartitionBounds bounds = partition_records<KeySize>(
+            keys.data(), partitioned.data(), num_keys, key_size,
+            [&](size_t i)
+            { return digits[i * key_size]; },
+            &ctx, num_threads);
+
+        // Step 2: Sort each bucket in parallel, writing it back into the original arena
+        const KeyLess<KeySize> less(key_size);
+        TaskGroup group(ctx);
+        for (size_t b = 0; b < RADIX; ++b)
         {
-            uint8_t b = key[byte_index];
-            temp[prefix_sum[b]++] = key;
+            if (bounds[b] == bounds[b + 1])
+                continue;
+            group.spawn([&, b]
+                        {
+                std::vector<uint32_t> order(bounds[b + 1] - bounds[b]);
+                std::iota(order.begin(), order.end(), static_cast<uint32_t>(bounds[b]));
+                std::sort(order.begin(), order.end(),
+                          [&](uint32_t x, uint32_t y)
+                          { return less(partitioned[x], partitioned[y]); });
+                for (size_t i = 0; i < order.size(); ++i)
+                    std::memcpy(keys[bounds[b] + i], partitioned[order[i]], key_size); });
         }
-
-        // Copy back to original array
-        keys = temp;
+        group.sync();
     }
 }
 
-void radix_sort_parallel_msb(std::vector<ByteKey> &keys, size_t sort_byte_index)
+void radix_sort(KeyArena &keys)
+{
+    if (keys.empty())
+        return;
+    dispatch_key_size(keys.key_size(), [&](auto key_size)
+                      { radix_sort_impl<decltype(key_size)::value>(keys); });
+}
+
+void radix_sort_parallel_msb(
+    KeyArena &keys,
+    size_t sort_byte_index,
+    const ExecutionContext &ctx)
 {
     if (keys.empty())
         return;
+    dispatch_key_size(keys.key_size(), [&](auto key_size)
+                      { radix_sort_parallel_msb_impl<decltype(key_size)::value>(keys, sort_byte_index, ctx); });
+}
 
-    const size_t key_size = keys[0].size();
-    const size_t RADIX = 256;
+namespace
+{
+    // Buckets at least this large are sorted as separate tasks when a task group is available
+    constexpr size_t MSD_SPAWN_THRESHOLD = 1 << 14;
 
-    for (const auto &key : keys)
+    struct MsdContext
     {
-        if (key.size() != key_size)
-            throw std::invalid_argument("All keys must have the same length.");
-    }
+        const KeyView &keys;
+        size_t cutoff;
+        TaskGroup *group; // nullptr sorts everything on the calling thread
+    };
 
-    // Step 1: Distribute keys into 256 buckets by the byte at sort_byte_index
-    std::array<std::vector<ByteKey>, RADIX> buckets;
-    for (auto &key : keys)
+    // Comparison sort of a bucket whose keys agree on their first byte_index bytes
+    template <size_t KeySize>
+    void compare_sort(const KeyView &keys, RowID *rowids, size_t n, size_t byte_index)
     {
-        uint8_t b = key[sort_byte_index];
-        buckets[b].push_back(std::move(key));
+        if constexpr (KeySize != DYNAMIC_KEY_SIZE)
+        {
+            // Whole-word compares from byte 0 still beat memcmp on the remaining bytes
+            const uint8_t *key_data = keys.data();
+            const KeyLess<KeySize> less;
+            pdqsort(rowids, rowids + n,
+                    [&](const RowID &a, const RowID &c)
+                    { return less(key_data + row_index(a) * KeySize, key_data + row_index(c) * KeySize); });
+        }
+        else
+        {
+            const size_t remaining = keys.key_size() - byte_index;
+            pdqsort(rowids, rowids + n,
+                    [&](const RowID &a, const RowID &c)
+                    {
+                        return std::memcmp(keys[row_index(a)] + byte_index, keys[row_index(c)] + byte_index, remaining) < 0;
+                    });
+        }
     }
 
-    // Step 2: Sort each bucket in parallel
-    ThreadPool pool; // Uses hardware concurrency by default
-    std::vector<std::future<void>> futures;
-
-    for (size_t b = 0; b < RADIX; ++b)
+    // Leaf sort for at most SMALL_SORT_MAX RowIDs: every key is loaded once as an 8-byte prefix, the {prefix,
+    // position} pairs go through the branch-free sorting network and only runs of equal prefixes are compared on
+    // the full keys.
+    template <size_t KeySize>
+    void sort_small_bucket(const KeyView &keys, RowID *rowids, RowID *scratch, size_t n, size_t byte_index)
     {
-        if (!buckets[b].empty())
+        const size_t key_size = width_of<KeySize>(keys);
+        const uint8_t *key_data = keys.data();
+        uint64_t prefixes[SMALL_SORT_MAX];
+        uint32_t positions[SMALL_SORT_MAX];
+        for (size_t i = 0; i < n; ++i)
         {
-            futures.push_back(pool.enqueue([&bucket = buckets[b]]
-                                           { std::sort(bucket.begin(), bucket.end()); }));
+            prefixes[i] = load_key_prefix(key_data + row_index(rowids[i]) * key_size, key_size, byte_index);
+            positions[i] = static_cast<uint32_t>(i);
         }
-    }
+        small_sort(prefixes, positions, n);
+        for (size_t i = 0; i < n; ++i)
+            scratch[i] = rowids[positions[i]];
+        std::copy(scratch, scratch + n, rowids);
 
-    for (auto &fut : futures)
-        fut.get();
+        // With no key bytes after the prefix, equal prefixes are equal keys
+        if (byte_index + 8 >= key_size)
+            return;
+        for (size_t run = 0; run < n;)
+        {
+            size_t run_end = run + 1;
+            while (run_end < n && prefixes[run_end] == prefixes[run])
+                ++run_end;
+            if (run_end - run > 1)
+                compare_sort<KeySize>(keys, rowids + run, run_end - run, byte_index + 8);
+            run = run_end;
+        }
+    }
 
-    // Step 3: Reassemble sorted buckets into final array
-    keys.clear();
-    for (size_t b = 0; b < RADIX; ++b)
+    // digits is scratch space for n bytes; each child bucket reuses its own slice once the parent has scattered
+    template <size_t KeySize>
+    void msd_radix_recurse(
+        const MsdContext &ctx,
+        RowID *rowids,
+        RowID *scratch,
+        uint8_t *digits,
+        size_t n,
+        size_t byte_index)
     {
-        keys.insert(keys.end(),
-                    std::make_move_iterator(buckets[b].begin()),
-                    std::make_move_iterator(buckets[b].end()));
+        const KeyView &keys = ctx.keys;
+        const size_t key_size = width_of<KeySize>(keys);
+        const uint8_t *key_data = keys.data();
+        std::array<size_t, RADIX> count;
+
+        for (;;)
+        {
+            if (n <= 1 || byte_index >= key_size)
+                return;
+
+            if (n < ctx.cutoff)
+            {
+                if (n <= SMALL_SORT_MAX && small_sort_vectorized())
+                    sort_small_bucket<KeySize>(keys, rowids, scratch, n, byte_index);
+                else
+                    compare_sort<KeySize>(keys, rowids, n, byte_index);
+                return;
+            }
+
+            // Histogram on the current byte, caching the digits so the scatter does not reload the keys
+            count = {};
+            for (size_t i = 0; i < n; ++i)
+            {
+                const uint8_t b = key_data[row_index(rowids[i]) * key_size + byte_index];
+                digits[i] = b;
+                count[b]++;
+            }
+
+            // Byte is constant within this bucket: move on to the next one without scattering
+            if (count[digits[0]] != n)
+                break;
+            ++byte_index;
+        }
+
+        std::array<size_t, RADIX> fill;
+        size_t sum = 0;
+        for (size_t b = 0; b < RADIX; ++b)
+        {
+            fill[b] = sum;
+            sum += count[b];
+        }
+        scatter_by_digits<sizeof(RowID)>(
+            reinterpret_cast<const uint8_t *>(rowids), reinterpret_cast<uint8_t *>(scratch), digits, 0, n, sizeof(RowID), fill);
+        std::copy(scratch, scratch + n, rowids);
+
+        size_t bucket_begin = 0;
+        for (size_t b = 0; b < RADIX; ++b)
+        {
+            const size_t bucket_size = count[b];
+            if (bucket_size > 1)
+            {
+                RowID *child = rowids + bucket_begin;
+                RowID *child_scratch = scratch + bucket_begin;
+                uint8_t *child_digits = digits + bucket_begin;
+                const size_t child_byte = byte_index + 1;
+                if (ctx.group != nullptr && bucket_size >= MSD_SPAWN_THRESHOLD)
+                    ctx.group->spawn([&ctx, child, child_scratch, child_digits, bucket_size, child_byte]
+                                     {
+                        // Stolen children run outside the runner that spawned them
+                        const PerfPhase phase("leaf sort");
+                        msd_radix_recurse<KeySize>(ctx, child, child_scratch, child_digits, bucket_size, child_byte); });
+                else
+                    msd_radix_recurse<KeySize>(ctx, child, child_scratch, child_digits, bucket_size, child_byte);
+            }
+            bucket_begin += bucket_size;
+        }
     }
 }
 
+void msd_radix_sort_rowids(
+    const KeyView &keys,
+    RowID *rowids,
+    RowID *scratch,
+    size_t n,
+    size_t byte_index,
+    size_t cutoff)
+{
+    std::vector<uint8_t> digits(n);
+    const MsdContext ctx{keys, cutoff, nullptr};
+    dispatch_key_size(keys.key_size(), [&](auto key_size)
+                      { msd_radix_recurse<decltype(key_size)::value>(ctx, rowids, scratch, digits.data(), n, byte_index); });
+}
+
 void hybrid_radix_sort_rowids_msb(
-    const std::vector<ByteKey> &keys,
-    std::vector<RowID> &rowids)
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    size_t cutoff,
+    TieBreak tie_break)
 {
     if (rowids.empty())
         return;
-    constexpr size_t RADIX = 256;
-    constexpr size_t msb_index = 0; // which byte to bucket on (0 = most significant)
-
-    // 1) Create empty buckets
-    std::array<std::vector<RowID>, RADIX> buckets;
-
-    // 2) Distribute by MSB
-    for (auto &rid : rowids)
-    {
-        size_t idx = rid.chunk_id * CHUNK_SIZE + rid.chunk_offset;
-        uint8_t b = keys[idx][msb_index];
-        buckets[b].push_back(rid);
-    }
-
-    // 3) Sort each bucket in parallel
-    ThreadPool pool; // Uses hardware concurrency by default
-    std::vector<std::future<void>> futures;
+    const size_t n = rowids.size();
+    const size_t num_threads = ctx.num_threads();
 
-    for (size_t b = 0; b < RADIX; ++b)
-    {
-        if (buckets[b].empty())
-            continue;
-        // spawn a thread up to hw
-        futures.push_back(pool.enqueue(
-            [&buckets, &keys, b]()
-            {
-                auto &bucket = buckets[b];
-                pdqsort(bucket.begin(), bucket.end(),
-                        [&](const RowID &a, const RowID &c)
-                        {
-                            const auto &A = keys[a.chunk_id * CHUNK_SIZE + a.chunk_offset];
-                            const auto &C = keys[c.chunk_id * CHUNK_SIZE + c.chunk_offset];
-                            return A < C;
-                        });
-            }));
-    }
+    // 1) Partition with all threads until every bucket is at most one thread's share of the input. On uniform data
+    //    this is the single MSB split; skewed buckets are split further on their next byte.
+    std::vector<RowID> partitioned(n);
+    RowID *const buffers[2] = {rowids.data(), partitioned.data()};
+    const size_t max_leaf = std::max(MSD_SPAWN_THRESHOLD, n / num_threads);
+    std::vector<LeafBucket> leaves;
+    split_oversized<RADIX>(ctx, buffers, 0, n, 0, 0, max_leaf, keys.key_size(),
+                           [&](const RowID &rid, size_t byte_index)
+                           { return keys[row_index(rid)][byte_index]; },
+                           leaves);
+    const int target = result_buffer(leaves, n);
 
-    // wait on any worker threads
-    for (auto &fut : futures)
-        fut.get();
+    // 2) Sort the leaves largest-first, spawning large sub-buckets into the runners' group
+    std::vector<uint8_t> digits(n);
+    TaskGroup runners(ctx);
+    const MsdContext msd{keys, cutoff, &runners};
+    sort_leaves(ctx, runners, buffers, leaves, [&](const LeafBucket &leaf, RowID *data, RowID *other)
+                {
+        const PerfPhase phase("leaf sort");
+        dispatch_key_size(keys.key_size(), [&](auto key_size)
+                          { msd_radix_recurse<decltype(key_size)::value>(msd, data, other, digits.data() + leaf.begin, leaf.size, leaf.depth); }); });
+    gather_leaves(ctx, buffers, leaves, target);
 
-    // 4) Gather back in bucket order
-    rowids.clear();
-    for (size_t b = 0; b < RADIX; ++b)
-    {
-        auto &bucket = buckets[b];
-        rowids.insert(
-            rowids.end(),
-            std::make_move_iterator(bucket.begin()),
-            std::make_move_iterator(bucket.end()));
-    }
+    // 3) Hand back the buffer holding the sorted RowIDs
+    if (target == 1)
+        rowids.swap(partitioned);
+    if (tie_break == TieBreak::RowID)
+        order_ties_by_rowid(keys, rowids, ctx);
 }
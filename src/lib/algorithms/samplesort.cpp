@@ -0,0 +1,581 @@
+#include "algorithms/samplesort.hpp"
+
+#include <array>
+#include <atomic>
+#include <algorithm>
+#include <pdqsort.h>
+
+#include "key_compare.hpp"
+#include "key_prefix.hpp"
+#include "utils/perf_counters.hpp"
+
+namespace
+{
+    // RowIDs per block: the unit that classification writes back and the block permutation moves
+    constexpr size_t BLOCK_SIZE = 2048 / sizeof(RowID);
+    // Subproblems up to this size are sorted with pdqsort
+    constexpr size_t BASE_CASE_SIZE = 1024;
+    // Subproblems need this many RowIDs per thread before they are partitioned by more than one thread
+    constexpr size_t PARALLEL_MIN_SIZE = 1 << 16;
+    // At most 2^7 splitter-tree leaves; with an equality bucket per splitter that gives at most 255 buckets
+    constexpr size_t MAX_LOG_LEAVES = 7;
+    constexpr size_t MAX_LEAVES = size_t{1} << MAX_LOG_LEAVES;
+    constexpr size_t MAX_BUCKETS = 2 * MAX_LEAVES - 1;
+    // Keys classified together, so that their key loads are in flight at the same time
+    constexpr size_t CLASSIFY_BATCH = 8;
+
+    using BucketBounds = std::array<size_t, MAX_BUCKETS + 1>;
+
+    size_t floor_log2(size_t x)
+    {
+        return 63 - __builtin_clzll(x);
+    }
+
+    size_t ceil_div(size_t a, size_t b)
+    {
+        return (a + b - 1) / b;
+    }
+
+    // Key bytes of one sort; keys are compared on their first 8 bytes as an integer before touching the rest
+    template <size_t KeySize>
+    struct SampleKeys
+    {
+        const uint8_t *data;
+        size_t key_size;
+        KeyLess<KeySize> less;
+
+        explicit SampleKeys(const KeyView &keys)
+            : data(keys.data()),
+              key_size(KeySize != DYNAMIC_KEY_SIZE ? KeySize : keys.key_size()),
+              less(key_size) {}
+
+        const uint8_t *key(const RowID &rid) const { return data + row_index(rid) * key_size; }
+        uint64_t prefix(const uint8_t *key) const { return load_key_prefix(key, key_size); }
+        // Whether keys with equal prefixes can still differ
+        bool has_suffix() const { return key_size > 8; }
+    };
+
+    /**
+     * Maps keys to buckets by descending an implicit binary search tree over the splitters. With L leaves, bucket
+     * 2 * i holds the keys between splitters i - 1 and i and bucket 2 * i + 1 the keys equal to splitter i, so
+     * there are 2 * L - 1 buckets in key order.
+     */
+    template <size_t KeySize>
+    class Classifier
+    {
+    public:
+        // splitters must be sorted, distinct and fewer than MAX_LEAVES
+        Classifier(const SampleKeys<KeySize> &keys, const std::vector<const uint8_t *> &splitters)
+            : _keys(keys)
+        {
+            _log_leaves = 1;
+            while ((size_t{1} << _log_leaves) <= splitters.size())
+                ++_log_leaves;
+            _num_leaves = size_t{1} << _log_leaves;
+
+            // Pad to a complete tree by repeating the largest splitter; the buckets behind the copies stay empty
+            for (size_t i = 0; i + 1 < _num_leaves; ++i)
+            {
+                _sorted[i] = splitters[std::min(i, splitters.size() - 1)];
+                _sorted_prefix[i] = keys.prefix(_sorted[i]);
+            }
+            size_t next = 0;
+            build_tree(1, next);
+        }
+
+        size_t num_buckets() const { return 2 * _num_leaves - 1; }
+
+        size_t classify(const RowID &rid) const
+        {
+            const uint8_t *key = _keys.key(rid);
+            const uint64_t prefix = _keys.prefix(key);
+            size_t node = 1;
+            for (size_t level = 0; level < _log_leaves; ++level)
+                node = 2 * node + splitter_less(node, prefix, key);
+            return to_bucket(node - _num_leaves, prefix, key);
+        }
+
+        // Classifies CLASSIFY_BATCH RowIDs level by level, interleaving the independent tree descents
+        void classify_batch(const RowID *rids, size_t *buckets) const
+        {
+            const uint8_t *keys[CLASSIFY_BATCH];
+            uint64_t prefixes[CLASSIFY_BATCH];
+            size_t nodes[CLASSIFY_BATCH];
+            for (size_t u = 0; u < CLASSIFY_BATCH; ++u)
+            {
+                keys[u] = _keys.key(rids[u]);
+                prefixes[u] = _keys.prefix(keys[u]);
+                nodes[u] = 1;
+            }
+            for (size_t level = 0; level < _log_leaves; ++level)
+            {
+                for (size_t u = 0; u < CLASSIFY_BATCH; ++u)
+                    nodes[u] = 2 * nodes[u] + splitter_less(nodes[u], prefixes[u], keys[u]);
+            }
+            for (size_t u = 0; u < CLASSIFY_BATCH; ++u)
+                buckets[u] = to_bucket(nodes[u] - _num_leaves, prefixes[u], keys[u]);
+        }
+
+    private:
+        // Lays the sorted splitters out in-order, so node n has children 2n and 2n + 1
+        void build_tree(size_t node, size_t &next)
+        {
+            if (node >= _num_leaves)
+                return;
+            build_tree(2 * node, next);
+            _tree_prefix[node] = _sorted_prefix[next];
+            _tree_key[node] = _sorted[next];
+            ++next;
+            build_tree(2 * node + 1, next);
+        }
+
+        // Equal prefixes are rare outside of heavy duplicates, so the full comparison is behind a predictable branch
+        bool splitter_less(size_t node, uint64_t prefix, const uint8_t *key) const
+        {
+            const uint64_t splitter_prefix = _tree_prefix[node];
+            if (splitter_prefix != prefix)
+                return splitter_prefix < prefix;
+            return _keys.has_suffix() && _keys.less(_tree_key[node], key);
+        }
+
+        // leaf is the number of splitters below the key, so the key is at most splitter leaf
+        size_t to_bucket(size_t leaf, uint64_t prefix, const uint8_t *key) const
+        {
+            const bool equal = leaf + 1 < _num_leaves && _sorted_prefix[leaf] == prefix &&
+                               (!_keys.has_suffix() || !_keys.less(key, _sorted[leaf]));
+            return 2 * leaf + equal;
+        }
+
+        const SampleKeys<KeySize> &_keys;
+        size_t _log_leaves;
+        size_t _num_leaves;
+        std::array<uint64_t, MAX_LEAVES> _tree_prefix;
+        std::array<const uint8_t *, MAX_LEAVES> _tree_key;
+        std::array<uint64_t, MAX_LEAVES> _sorted_prefix;
+        std::array<const uint8_t *, MAX_LEAVES> _sorted;
+    };
+
+    // Sorts an oversampled random sample and takes evenly spaced, distinct splitters from it
+    template <size_t KeySize>
+    std::vector<const uint8_t *> select_splitters(const SampleKeys<KeySize> &keys, const RowID *rows, size_t n)
+    {
+        const size_t log_leaves = std::clamp<size_t>(floor_log2(n / BASE_CASE_SIZE) + 1, 1, MAX_LOG_LEAVES);
+        const size_t oversampling = std::max<size_t>(1, floor_log2(n) / 5);
+        const size_t sample_size = std::min(n, oversampling * (size_t{1} << log_leaves) - 1);
+
+        // xorshift seeded from n keeps runs reproducible
+        std::vector<const uint8_t *> sample(sample_size);
+        uint64_t state = n * 0x9E3779B97F4A7C15ull + 1;
+        for (auto &key : sample)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            key = keys.key(rows[state % n]);
+        }
+        pdqsort(sample.begin(), sample.end(), [&](const uint8_t *a, const uint8_t *b)
+                { return keys.less(a, b); });
+
+        std::vector<const uint8_t *> splitters;
+        for (size_t i = oversampling - 1; i < sample_size; i += oversampling)
+        {
+            if (splitters.empty() || keys.less(splitters.back(), sample[i]))
+                splitters.push_back(sample[i]);
+        }
+        return splitters;
+    }
+
+    // One thread's share of the range during classification
+    struct Stripe
+    {
+        size_t begin;
+        size_t write;                         // end of the full blocks written back to [begin, write)
+        std::array<size_t, MAX_BUCKETS> fill; // RowIDs waiting in every bucket's buffer
+        std::vector<RowID> buffers;           // one BLOCK_SIZE buffer per bucket
+        std::vector<uint8_t> blocks;          // bucket of every block written back, in order
+    };
+
+    // Memory of one partitioning step besides the RowIDs; a sequential sort reuses it for every step
+    struct Workspace
+    {
+        std::vector<Stripe> stripes;
+        std::vector<int16_t> slot_bucket;  // bucket of the full block in every slot, -1 when empty
+        std::vector<size_t> slot_target;   // slot every full block moves to
+        std::vector<uint8_t> slot_state;   // TAKEN and VISITED flags
+        std::vector<size_t> moves;         // slots of all chains and cycles of the block permutation
+        std::vector<size_t> move_bounds;   // where every chain or cycle starts in moves
+        std::vector<RowID> overflow;       // part of a block that was moved past the end of the range
+        std::vector<RowID> spilled;        // per bucket: RowIDs its last block put behind the bucket end
+    };
+
+    constexpr uint8_t TAKEN = 1;
+    constexpr uint8_t VISITED = 2;
+
+    // Runs fn(part) for every part, as tasks when a context is given
+    template <class F>
+    void for_each_part(const ExecutionContext *ctx, size_t parts, F &&fn)
+    {
+        if (ctx != nullptr)
+        {
+            parallel_for(*ctx, parts, fn);
+            return;
+        }
+        for (size_t part = 0; part < parts; ++part)
+            fn(part);
+    }
+
+    // Classifies the stripe into per-bucket buffers. A full buffer is written back as one block to the front of
+    // the stripe, which never overtakes the reads, so afterwards the stripe starts with single-bucket blocks and
+    // the remaining RowIDs sit in the buffers.
+    template <size_t KeySize>
+    void classify_stripe(const Classifier<KeySize> &classifier, RowID *rows, Stripe &stripe, size_t begin, size_t end)
+    {
+        const size_t num_buckets = classifier.num_buckets();
+        stripe.begin = begin;
+        stripe.write = begin;
+        std::fill_n(stripe.fill.begin(), num_buckets, 0);
+        stripe.blocks.clear();
+        if (stripe.buffers.size() < num_buckets * BLOCK_SIZE)
+            stripe.buffers.resize(num_buckets * BLOCK_SIZE);
+        RowID *buffers = stripe.buffers.data();
+
+        auto push = [&](const RowID &rid, size_t bucket)
+        {
+            RowID *buffer = buffers + bucket * BLOCK_SIZE;
+            buffer[stripe.fill[bucket]++] = rid;
+            if (stripe.fill[bucket] == BLOCK_SIZE)
+            {
+                std::copy(buffer, buffer + BLOCK_SIZE, rows + stripe.write);
+                stripe.write += BLOCK_SIZE;
+                stripe.blocks.push_back(static_cast<uint8_t>(bucket));
+                stripe.fill[bucket] = 0;
+            }
+        };
+
+        size_t i = begin;
+        for (; i + CLASSIFY_BATCH <= end; i += CLASSIFY_BATCH)
+        {
+            RowID batch[CLASSIFY_BATCH];
+            size_t buckets[CLASSIFY_BATCH];
+            std::copy(rows + i, rows + i + CLASSIFY_BATCH, batch);
+            classifier.classify_batch(batch, buckets);
+            for (size_t u = 0; u < CLASSIFY_BATCH; ++u)
+                push(batch[u], buckets[u]);
+        }
+        for (; i < end; ++i)
+        {
+            const RowID rid = rows[i];
+            push(rid, classifier.classify(rid));
+        }
+    }
+
+    /**
+     * Partitions rows[0, n) into the classifier's buckets in place and returns the number of buckets.
+     *
+     * 1) Every stripe is classified into full blocks at its front and partial buffers (classify_stripe).
+     * 2) The array is viewed as BLOCK_SIZE slots. Bucket b owns the slots that start inside its final range, and
+     *    its full blocks go to the first of those. Blocks already there stay; the moves of the others form chains
+     *    that end in an empty slot and cycles, which are independent and are executed in parallel.
+     * 3) The last block of a bucket may reach past the bucket end; those RowIDs and the partial buffers fill the
+     *    gaps at the head and tail of every bucket.
+     *
+     * @param ctx           runs every phase with one task per stripe; nullptr partitions on the calling thread
+     * @param num_stripes   number of stripes the range is classified in
+     * @param bounds        receives the num_buckets + 1 bucket boundaries
+     */
+    template <size_t KeySize>
+    size_t partition(
+        const Classifier<KeySize> &classifier,
+        RowID *rows,
+        size_t n,
+        Workspace &ws,
+        const ExecutionContext *ctx,
+        size_t num_stripes,
+        BucketBounds &bounds)
+    {
+        const size_t num_buckets = classifier.num_buckets();
+
+        // 1) Classification, one stripe per task. Stripes start at slot boundaries.
+        const size_t stripe_size = ceil_div(ceil_div(n, num_stripes), BLOCK_SIZE) * BLOCK_SIZE;
+        num_stripes = ceil_div(n, stripe_size);
+        if (ws.stripes.size() < num_stripes)
+            ws.stripes.resize(num_stripes);
+        for_each_part(ctx, num_stripes, [&](size_t t)
+                      {
+            const PerfPhase phase("histogram");
+            classify_stripe(classifier, rows, ws.stripes[t], t * stripe_size, std::min(n, (t + 1) * stripe_size)); });
+
+        // 2) Bucket boundaries, and the slots every bucket's full blocks move to
+        std::array<size_t, MAX_BUCKETS> full_blocks{};
+        std::array<size_t, MAX_BUCKETS> partial{};
+        for (size_t t = 0; t < num_stripes; ++t)
+        {
+            for (const uint8_t bucket : ws.stripes[t].blocks)
+                ++full_blocks[bucket];
+            for (size_t b = 0; b < num_buckets; ++b)
+                partial[b] += ws.stripes[t].fill[b];
+        }
+        std::array<size_t, MAX_BUCKETS> first_slot;
+        bounds[0] = 0;
+        for (size_t b = 0; b < num_buckets; ++b)
+        {
+            bounds[b + 1] = bounds[b] + full_blocks[b] * BLOCK_SIZE + partial[b];
+            first_slot[b] = ceil_div(bounds[b], BLOCK_SIZE);
+        }
+
+        const size_t num_slots = ceil_div(n, BLOCK_SIZE);
+        ws.slot_bucket.assign(num_slots, -1);
+        ws.slot_target.resize(num_slots);
+        ws.slot_state.assign(num_slots, 0);
+        for (size_t t = 0; t < num_stripes; ++t)
+        {
+            const Stripe &stripe = ws.stripes[t];
+            for (size_t j = 0; j < stripe.blocks.size(); ++j)
+                ws.slot_bucket[stripe.begin / BLOCK_SIZE + j] = stripe.blocks[j];
+        }
+
+        auto in_place = [&](size_t slot)
+        {
+            const int16_t bucket = ws.slot_bucket[slot];
+            return bucket >= 0 && slot >= first_slot[bucket] && slot < first_slot[bucket] + full_blocks[bucket];
+        };
+        for (size_t s = 0; s < num_slots; ++s)
+        {
+            if (in_place(s))
+            {
+                ws.slot_target[s] = s;
+                ws.slot_state[s] = TAKEN;
+            }
+        }
+        std::array<size_t, MAX_BUCKETS> next_slot = first_slot;
+        for (size_t s = 0; s < num_slots; ++s)
+        {
+            const int16_t bucket = ws.slot_bucket[s];
+            if (bucket < 0 || in_place(s))
+                continue;
+            size_t target = next_slot[bucket];
+            while (ws.slot_state[target] & TAKEN)
+                ++target;
+            ws.slot_target[s] = target;
+            ws.slot_state[target] |= TAKEN;
+            next_slot[bucket] = target + 1;
+        }
+
+        // A moving block whose slot nobody moves into starts a chain; the moving blocks left over form cycles
+        auto moving = [&](size_t slot)
+        {
+            return ws.slot_bucket[slot] >= 0 && ws.slot_target[slot] != slot;
+        };
+        ws.moves.clear();
+        ws.move_bounds.assign(1, 0);
+        for (size_t s = 0; s < num_slots; ++s)
+        {
+            if (!moving(s) || (ws.slot_state[s] & TAKEN))
+                continue;
+            size_t slot = s;
+            for (; ws.slot_bucket[slot] >= 0; slot = ws.slot_target[slot])
+            {
+                ws.moves.push_back(slot);
+                ws.slot_state[slot] |= VISITED;
+            }
+            ws.moves.push_back(slot);
+            ws.move_bounds.push_back(ws.moves.size());
+        }
+        for (size_t s = 0; s < num_slots; ++s)
+        {
+            if (!moving(s) || (ws.slot_state[s] & VISITED))
+                continue;
+            size_t slot = s;
+            do
+            {
+                ws.moves.push_back(slot);
+                ws.slot_state[slot] |= VISITED;
+                slot = ws.slot_target[slot];
+            } while (slot != s);
+            ws.move_bounds.push_back(ws.moves.size());
+        }
+
+        // 3) Block permutation. Chains move back to front into their empty last slot, cycles go through one block
+        //    of scratch. Only the last slot can reach past n; that part of it goes to the overflow buffer.
+        if (ws.overflow.size() < BLOCK_SIZE)
+            ws.overflow.resize(BLOCK_SIZE);
+        auto store_block = [&](const RowID *block, size_t slot)
+        {
+            const size_t begin = slot * BLOCK_SIZE;
+            const size_t in_range = std::min(BLOCK_SIZE, n - begin);
+            std::copy(block, block + in_range, rows + begin);
+            std::copy(block + in_range, block + BLOCK_SIZE, ws.overflow.data());
+        };
+        const size_t num_groups = ws.move_bounds.size() - 1;
+        for_each_part(ctx, num_stripes, [&](size_t t)
+                      {
+            const PerfPhase phase("scatter");
+            // Split by moved slots rather than by groups, so one long cycle does not unbalance the tasks
+            const auto group_at = [&](size_t part)
+            {
+                const size_t move = ws.moves.size() * part / num_stripes;
+                return static_cast<size_t>(std::lower_bound(ws.move_bounds.begin(), ws.move_bounds.end() - 1, move) -
+                                           ws.move_bounds.begin());
+            };
+            std::array<RowID, BLOCK_SIZE> scratch;
+            for (size_t g = group_at(t); g < std::min(group_at(t + 1), num_groups); ++g)
+            {
+                const size_t *slots = ws.moves.data() + ws.move_bounds[g];
+                const size_t length = ws.move_bounds[g + 1] - ws.move_bounds[g];
+                const bool cycle = ws.slot_bucket[slots[length - 1]] >= 0;
+                if (cycle)
+                {
+                    const RowID *last = rows + slots[length - 1] * BLOCK_SIZE;
+                    std::copy(last, last + BLOCK_SIZE, scratch.data());
+                }
+                for (size_t i = length - 1; i > 0; --i)
+                    store_block(rows + slots[i - 1] * BLOCK_SIZE, slots[i]);
+                if (cycle)
+                    store_block(scratch.data(), slots[0]);
+            } });
+
+        // 4) Cleanup. The spilled RowIDs sit in the head of the following buckets, so all of them are saved before
+        //    any bucket fills its gaps.
+        if (ws.spilled.size() < num_buckets * BLOCK_SIZE)
+            ws.spilled.resize(num_buckets * BLOCK_SIZE);
+        auto blocks_end = [&](size_t b)
+        {
+            return (first_slot[b] + full_blocks[b]) * BLOCK_SIZE;
+        };
+        auto spilled_size = [&](size_t b)
+        {
+            return full_blocks[b] > 0 && blocks_end(b) > bounds[b + 1] ? blocks_end(b) - bounds[b + 1] : 0;
+        };
+        auto for_each_bucket = [&](auto &&fn)
+        {
+            for_each_part(ctx, num_stripes, [&](size_t t)
+                          {
+                const PerfPhase phase("scatter");
+                for (size_t b = num_buckets * t / num_stripes; b < num_buckets * (t + 1) / num_stripes; ++b)
+                    fn(b); });
+        };
+        for_each_bucket([&](size_t b)
+                        {
+            RowID *spilled = ws.spilled.data() + b * BLOCK_SIZE;
+            for (size_t pos = bounds[b + 1]; pos < bounds[b + 1] + spilled_size(b); ++pos)
+                *spilled++ = pos < n ? rows[pos] : ws.overflow[pos - n]; });
+        for_each_bucket([&](size_t b)
+                        {
+            const size_t end = bounds[b + 1];
+            const size_t head_end = std::min(first_slot[b] * BLOCK_SIZE, end);
+            const size_t tail_begin = full_blocks[b] > 0 ? std::min(blocks_end(b), end) : head_end;
+            size_t pos = bounds[b];
+            auto place = [&](const RowID *source, size_t count)
+            {
+                while (count > 0)
+                {
+                    if (pos == head_end)
+                        pos = tail_begin;
+                    const size_t gap_end = pos < head_end ? head_end : end;
+                    const size_t len = std::min(count, gap_end - pos);
+                    std::copy(source, source + len, rows + pos);
+                    pos += len;
+                    source += len;
+                    count -= len;
+                }
+            };
+            place(ws.spilled.data() + b * BLOCK_SIZE, spilled_size(b));
+            for (size_t t = 0; t < num_stripes; ++t)
+                place(ws.stripes[t].buffers.data() + b * BLOCK_SIZE, ws.stripes[t].fill[b]); });
+
+        return num_buckets;
+    }
+
+    template <size_t KeySize>
+    void base_case(const SampleKeys<KeySize> &keys, RowID *rows, size_t n)
+    {
+        const PerfPhase phase("leaf sort");
+        pdqsort(rows, rows + n, [&](const RowID &a, const RowID &b)
+                { return keys.less(keys.key(a), keys.key(b)); });
+    }
+
+    // Sorts on the calling thread; ws is free again whenever a bucket is recursed into
+    template <size_t KeySize>
+    void sort_sequential(const SampleKeys<KeySize> &keys, RowID *rows, size_t n, Workspace &ws)
+    {
+        if (n <= BASE_CASE_SIZE)
+        {
+            base_case(keys, rows, n);
+            return;
+        }
+        const Classifier<KeySize> classifier(keys, select_splitters(keys, rows, n));
+        BucketBounds bounds;
+        const size_t num_buckets = partition(classifier, rows, n, ws, nullptr, 1, bounds);
+        // Odd buckets hold copies of one splitter and are already sorted
+        for (size_t b = 0; b < num_buckets; b += 2)
+        {
+            if (bounds[b + 1] - bounds[b] > 1)
+                sort_sequential(keys, rows + bounds[b], bounds[b + 1] - bounds[b], ws);
+        }
+    }
+
+    // Workspace of the sequential sorts; they never wait on other tasks, so one per thread is enough
+    Workspace &thread_workspace()
+    {
+        thread_local Workspace ws;
+        return ws;
+    }
+
+    template <size_t KeySize>
+    void sort_parallel(const SampleKeys<KeySize> &keys, RowID *rows, size_t n, const ExecutionContext &ctx)
+    {
+        const size_t num_threads = ctx.num_threads();
+        if (num_threads == 1 || n < PARALLEL_MIN_SIZE * num_threads)
+        {
+            sort_sequential(keys, rows, n, thread_workspace());
+            return;
+        }
+
+        const Classifier<KeySize> classifier(keys, select_splitters(keys, rows, n));
+        BucketBounds bounds;
+        size_t num_buckets;
+        {
+            Workspace ws;
+            num_buckets = partition(classifier, rows, n, ws, &ctx, num_threads, bounds);
+        }
+
+        // Buckets larger than one thread's share are partitioned again with all threads, one after the other. The
+        // rest are sorted sequentially, largest first: every runner grabs the largest bucket not taken yet.
+        std::vector<std::pair<size_t, size_t>> small; // {size, begin}
+        for (size_t b = 0; b < num_buckets; b += 2)
+        {
+            const size_t size = bounds[b + 1] - bounds[b];
+            if (size > n / num_threads)
+                sort_parallel(keys, rows + bounds[b], size, ctx);
+            else if (size > 1)
+                small.emplace_back(size, bounds[b]);
+        }
+        std::sort(small.begin(), small.end(), std::greater<>());
+        std::atomic<size_t> next{0};
+        TaskGroup runners(ctx);
+        for (size_t t = 0; t < std::min(num_threads, small.size()); ++t)
+        {
+            runners.spawn([&]
+                          {
+                for (size_t i; (i = next.fetch_add(1)) < small.size();)
+                    sort_sequential(keys, rows + small[i].second, small[i].first, thread_workspace()); });
+        }
+        runners.sync();
+    }
+}
+
+void samplesort_rowids(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    TieBreak tie_break)
+{
+    if (rowids.size() <= 1)
+        return;
+    dispatch_key_size(keys.key_size(), [&](auto key_size)
+                      {
+        const SampleKeys<decltype(key_size)::value> sample_keys(keys);
+        sort_parallel(sample_keys, rowids.data(), rowids.size(), ctx); });
+    if (tie_break == TieBreak::RowID)
+        order_ties_by_rowid(keys, rowids, ctx);
+}
@@ -0,0 +1,254 @@
+#include "algorithms/small_sort.hpp"
+
+#include <limits>
+
+#include "simd_isa.hpp"
+
+namespace
+{
+    // Payload of padding entries; real payloads are 32-bit so this never collides with one
+    constexpr uint64_t SENTINEL_VALUE = uint64_t{1} << 32;
+
+    // Copies the input into keys/values and pads it to a power of two (at least min_size) with maximal keys
+    size_t pad_input(const uint64_t *prefixes, const uint32_t *indices, size_t n, size_t min_size,
+                     uint64_t *keys, uint64_t *values)
+    {
+        size_t size = min_size;
+        while (size < n)
+            size *= 2;
+        for (size_t i = 0; i < n; ++i)
+        {
+            keys[i] = prefixes[i];
+            values[i] = indices[i];
+        }
+        for (size_t i = n; i < size; ++i)
+        {
+            keys[i] = std::numeric_limits<uint64_t>::max();
+            values[i] = SENTINEL_VALUE;
+        }
+        return size;
+    }
+
+    // Copies the n real entries back. Real prefixes equal to the padding key may have been sorted behind some
+    // padding, so the padding is skipped by payload rather than by position.
+    void unpad_output(const uint64_t *keys, const uint64_t *values, size_t n, uint64_t *prefixes, uint32_t *indices)
+    {
+        size_t out = 0;
+        for (size_t i = 0; out < n; ++i)
+        {
+            prefixes[out] = keys[i];
+            indices[out] = static_cast<uint32_t>(values[i]);
+            out += values[i] != SENTINEL_VALUE;
+        }
+    }
+
+    // Bitonic network for a power-of-two size. Element i is compared with i ^ j and sorted ascending when bit k
+    // of i is clear, descending otherwise; the direction is the same for a whole block of 2 * j elements.
+    void bitonic_scalar(uint64_t *keys, uint64_t *values, size_t size)
+    {
+        for (size_t k = 2; k <= size; k *= 2)
+        {
+            for (size_t j = k / 2; j > 0; j /= 2)
+            {
+                for (size_t base = 0; base < size; base += 2 * j)
+                {
+                    const bool ascending = (base & k) == 0;
+                    for (size_t i = base; i < base + j; ++i)
+                    {
+                        const uint64_t a = keys[i];
+                        const uint64_t b = keys[i + j];
+                        const uint64_t va = values[i];
+                        const uint64_t vb = values[i + j];
+                        // All-ones when the pair is out of order; xor-swapping under the mask keeps this branch-free
+                        const uint64_t swap = 0 - static_cast<uint64_t>(ascending ? a > b : b > a);
+                        const uint64_t key_diff = (a ^ b) & swap;
+                        const uint64_t value_diff = (va ^ vb) & swap;
+                        keys[i] = a ^ key_diff;
+                        keys[i + j] = b ^ key_diff;
+                        values[i] = va ^ value_diff;
+                        values[i + j] = vb ^ value_diff;
+                    }
+                }
+            }
+        }
+    }
+
+#if SORT_SIMD_X86
+    __attribute__((target("avx2"))) void bitonic_avx2(uint64_t *keys, uint64_t *values, size_t size)
+    {
+        const __m256i lane = _mm256_setr_epi64x(0, 1, 2, 3);
+        const __m256i zero = _mm256_setzero_si256();
+        for (size_t k = 2; k <= size; k *= 2)
+        {
+            for (size_t j = k / 2; j > 0; j /= 2)
+            {
+                if (j >= 4)
+                {
+                    // Partners are in different vectors and the direction is the same for all lanes
+                    for (size_t i = 0; i < size; i += 4)
+                    {
+                        if (i & j)
+                            continue;
+                        __m256i *pa = reinterpret_cast<__m256i *>(keys + i);
+                        __m256i *pb = reinterpret_cast<__m256i *>(keys + i + j);
+                        __m256i *qa = reinterpret_cast<__m256i *>(values + i);
+                        __m256i *qb = reinterpret_cast<__m256i *>(values + i + j);
+                        const __m256i a = _mm256_loadu_si256(pa);
+                        const __m256i b = _mm256_loadu_si256(pb);
+                        const __m256i va = _mm256_loadu_si256(qa);
+                        const __m256i vb = _mm256_loadu_si256(qb);
+                        const __m256i swap = cmpgt_epu64(a, b);
+                        const __m256i lo = _mm256_blendv_epi8(a, b, swap);
+                        const __m256i hi = _mm256_blendv_epi8(b, a, swap);
+                        const __m256i vlo = _mm256_blendv_epi8(va, vb, swap);
+                        const __m256i vhi = _mm256_blendv_epi8(vb, va, swap);
+                        const bool ascending = (i & k) == 0;
+                        _mm256_storeu_si256(pa, ascending ? lo : hi);
+                        _mm256_storeu_si256(pb, ascending ? hi : lo);
+                        _mm256_storeu_si256(qa, ascending ? vlo : vhi);
+                        _mm256_storeu_si256(qb, ascending ? vhi : vlo);
+                    }
+                    continue;
+                }
+
+                // Partners are lanes of the same vector: compare against a permuted copy and pick per lane
+                const __m256i jv = _mm256_set1_epi64x(static_cast<int64_t>(j));
+                const __m256i kv = _mm256_set1_epi64x(static_cast<int64_t>(k));
+                for (size_t i = 0; i < size; i += 4)
+                {
+                    __m256i *pk = reinterpret_cast<__m256i *>(keys + i);
+                    __m256i *pv = reinterpret_cast<__m256i *>(values + i);
+                    const __m256i v = _mm256_loadu_si256(pk);
+                    const __m256i vv = _mm256_loadu_si256(pv);
+                    const __m256i p = j == 1 ? _mm256_permute4x64_epi64(v, 0xB1) : _mm256_permute4x64_epi64(v, 0x4E);
+                    const __m256i pp = j == 1 ? _mm256_permute4x64_epi64(vv, 0xB1) : _mm256_permute4x64_epi64(vv, 0x4E);
+
+                    const __m256i idx = _mm256_add_epi64(_mm256_set1_epi64x(static_cast<int64_t>(i)), lane);
+                    const __m256i lower = _mm256_cmpeq_epi64(_mm256_and_si256(idx, jv), zero);
+                    const __m256i ascending = _mm256_cmpeq_epi64(_mm256_and_si256(idx, kv), zero);
+                    // The lower lane of an ascending pair and the upper lane of a descending pair keep the minimum
+                    const __m256i take_min = _mm256_cmpeq_epi64(lower, ascending);
+                    const __m256i take_partner = _mm256_blendv_epi8(cmpgt_epu64(p, v), cmpgt_epu64(v, p), take_min);
+                    _mm256_storeu_si256(pk, _mm256_blendv_epi8(v, p, take_partner));
+                    _mm256_storeu_si256(pv, _mm256_blendv_epi8(vv, pp, take_partner));
+                }
+            }
+        }
+    }
+
+    __attribute__((target("avx512f"))) void bitonic_avx512(uint64_t *keys, uint64_t *values, size_t size)
+    {
+        const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+        const __m512i zero = _mm512_setzero_si512();
+        for (size_t k = 2; k <= size; k *= 2)
+        {
+            for (size_t j = k / 2; j > 0; j /= 2)
+            {
+                if (j >= 8)
+                {
+                    for (size_t i = 0; i < size; i += 8)
+                    {
+                        if (i & j)
+                            continue;
+                        const __m512i a = _mm512_loadu_si512(keys + i);
+                        const __m512i b = _mm512_loadu_si512(keys + i + j);
+                        const __m512i va = _mm512_loadu_si512(values + i);
+                        const __m512i vb = _mm512_loadu_si512(values + i + j);
+                        const __mmask8 swap = _mm512_cmpgt_epu64_mask(a, b);
+                        const __m512i lo = _mm512_mask_blend_epi64(swap, a, b);
+                        const __m512i hi = _mm512_mask_blend_epi64(swap, b, a);
+                        const __m512i vlo = _mm512_mask_blend_epi64(swap, va, vb);
+                        const __m512i vhi = _mm512_mask_blend_epi64(swap, vb, va);
+                        const bool ascending = (i & k) == 0;
+                        _mm512_storeu_si512(keys + i, ascending ? lo : hi);
+                        _mm512_storeu_si512(keys + i + j, ascending ? hi : lo);
+                        _mm512_storeu_si512(values + i, ascending ? vlo : vhi);
+                        _mm512_storeu_si512(values + i + j, ascending ? vhi : vlo);
+                    }
+                    continue;
+                }
+
+                const __m512i jv = _mm512_set1_epi64(static_cast<int64_t>(j));
+                const __m512i kv = _mm512_set1_epi64(static_cast<int64_t>(k));
+                const __m512i partner = _mm512_xor_si512(lane, jv);
+                for (size_t i = 0; i < size; i += 8)
+                {
+                    const __m512i v = _mm512_loadu_si512(keys + i);
+                    const __m512i vv = _mm512_loadu_si512(values + i);
+                    const __m512i p = _mm512_mask_permutexvar_epi64(v, 0xFF, partner, v);
+                    const __m512i pp = _mm512_mask_permutexvar_epi64(vv, 0xFF, partner, vv);
+
+                    const __m512i idx = _mm512_add_epi64(_mm512_set1_epi64(static_cast<int64_t>(i)), lane);
+                    const __mmask8 lower = _mm512_cmpeq_epi64_mask(_mm512_and_si512(idx, jv), zero);
+                    const __mmask8 ascending = _mm512_cmpeq_epi64_mask(_mm512_and_si512(idx, kv), zero);
+                    const __mmask8 take_min = static_cast<__mmask8>(~(lower ^ ascending));
+                    const __mmask8 take_partner = static_cast<__mmask8>(
+                        (take_min & _mm512_cmpgt_epu64_mask(v, p)) | (~take_min & _mm512_cmpgt_epu64_mask(p, v)));
+                    _mm512_storeu_si512(keys + i, _mm512_mask_blend_epi64(take_partner, v, p));
+                    _mm512_storeu_si512(values + i, _mm512_mask_blend_epi64(take_partner, vv, pp));
+                }
+            }
+        }
+    }
+#endif
+
+    template <void (*Network)(uint64_t *, uint64_t *, size_t)>
+    void run_network(uint64_t *prefixes, uint32_t *indices, size_t n, size_t lanes)
+    {
+        if (n <= 1)
+            return;
+        alignas(64) uint64_t keys[SMALL_SORT_MAX];
+        alignas(64) uint64_t values[SMALL_SORT_MAX];
+        const size_t size = pad_input(prefixes, indices, n, lanes, keys, values);
+        Network(keys, values, size);
+        unpad_output(keys, values, n, prefixes, indices);
+    }
+}
+
+void small_sort_scalar(uint64_t *prefixes, uint32_t *indices, size_t n)
+{
+    run_network<bitonic_scalar>(prefixes, indices, n, 1);
+}
+
+#if SORT_SIMD_X86
+void small_sort_avx2(uint64_t *prefixes, uint32_t *indices, size_t n)
+{
+    run_network<bitonic_avx2>(prefixes, indices, n, 4);
+}
+
+void small_sort_avx512(uint64_t *prefixes, uint32_t *indices, size_t n)
+{
+    run_network<bitonic_avx512>(prefixes, indices, n, 8);
+}
+#else
+void small_sort_avx2(uint64_t *prefixes, uint32_t *indices, size_t n)
+{
+    small_sort_scalar(prefixes, indices, n);
+}
+
+void small_sort_avx512(uint64_t *prefixes, uint32_t *indices, size_t n)
+{
+    small_sort_scalar(prefixes, indices, n);
+}
+#endif
+
+void small_sort(uint64_t *prefixes, uint32_t *indices, size_t n)
+{
+    switch (simd_isa())
+    {
+    case SimdIsa::Avx512:
+        small_sort_avx512(prefixes, indices, n);
+        break;
+    case SimdIsa::Avx2:
+        small_sort_avx2(prefixes, indices, n);
+        break;
+    default:
+        small_sort_scalar(prefixes, indices, n);
+        break;
+    }
+}
+
+bool small_sort_vectorized()
+{
+    return simd_isa() != SimdIsa::Scalar;
+}
@@ -0,0 +1,90 @@
+#include "algorithms/tie_break.hpp"
+
+#include <algorithm>
+#include <pdqsort.h>
+
+#include "key_compare.hpp"
+
+namespace
+{
+    void sort_run(RowID *first, RowID *last)
+    {
+        const auto by_rowid = [](const RowID &a, const RowID &b)
+        { return rowid_key(a) < rowid_key(b); };
+        if (!std::is_sorted(first, last, by_rowid))
+            pdqsort_branchless(first, last, by_rowid);
+    }
+
+    // differs(i) is true if the key of rowids[i] is not equal to the one of rowids[i - 1]. Every part sorts the
+    // runs that start in its range, including the one that reaches into the next part. The run starts of all parts
+    // are found before any part sorts, so no part reads RowIDs that another one is moving.
+    template <typename Differs>
+    void order_runs(std::vector<RowID> &rowids, const ExecutionContext &ctx, Differs differs)
+    {
+        const size_t n = rowids.size();
+        const size_t parts = num_parallel_parts(ctx, n);
+
+        // first[p]: the first run that starts in part p or later
+        std::vector<size_t> first(parts + 1, n);
+        parallel_for(ctx, parts, [&](size_t p)
+                     {
+            const size_t end = (p + 1) * n / parts;
+            size_t run = p * n / parts;
+            while (run > 0 && run < end && !differs(run))
+                ++run;
+            first[p] = run; });
+        for (size_t p = parts; p-- > 0;)
+        {
+            if (first[p] == (p + 1) * n / parts)
+                first[p] = first[p + 1];
+        }
+
+        parallel_for(ctx, parts, [&](size_t p)
+                     {
+            for (size_t run = first[p]; run < first[p + 1];)
+            {
+                size_t run_end = run + 1;
+                while (run_end < first[p + 1] && !differs(run_end))
+                    ++run_end;
+                if (run_end - run > 1)
+                    sort_run(rowids.data() + run, rowids.data() + run_end);
+                run = run_end;
+            } });
+    }
+}
+
+void order_ties_by_rowid(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    const std::vector<size_t> *group_starts)
+{
+    if (group_starts != nullptr)
+    {
+        const size_t num_groups = group_starts->size() - 1;
+        const size_t parts = num_parallel_parts(ctx, rowids.size());
+        parallel_for(ctx, parts, [&](size_t p)
+                     {
+            const size_t end = (p + 1) * num_groups / parts;
+            for (size_t g = p * num_groups / parts; g < end; ++g)
+                sort_run(rowids.data() + (*group_starts)[g], rowids.data() + (*group_starts)[g + 1]); });
+        return;
+    }
+
+    dispatch_key_size(keys.key_size(), [&](auto width)
+                      {
+        const KeyLess<decltype(width)::value> less(keys.key_size());
+        // The RowIDs are sorted, so a key that is not equal to its predecessor is larger
+        order_runs(rowids, ctx, [&](size_t i)
+                   { return less(keys[row_index(rowids[i - 1])], keys[row_index(rowids[i])]); }); });
+}
+
+void order_ties_by_rowid(
+    const VarKeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx)
+{
+    const VarKeyLess less(keys);
+    order_runs(rowids, ctx, [&](size_t i)
+               { return less(keys[row_index(rowids[i - 1])], keys[row_index(rowids[i])]); });
+}
@@ -0,0 +1,142 @@
+#include "algorithms/top_k.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <pdqsort.h>
+
+#include "key_compare.hpp"
+#include "key_prefix.hpp"
+#include "algorithms/radix.hpp"
+
+namespace
+{
+    // Windows reaching past 1/FULL_SORT_DIVISOR of the input come from a full sort instead
+    constexpr size_t FULL_SORT_DIVISOR = 8;
+
+    // PrefixRecordLess, made a total order by RowID if ByRowID is set, so that equal keys at the window edges
+    // always select the same rows
+    template <size_t TailSize, bool ByRowID>
+    struct WindowLess
+    {
+        PrefixRecordLess<TailSize> less;
+
+        explicit WindowLess(const KeyView &keys) : less(keys) {}
+
+        bool operator()(const PrefixRecord &a, const PrefixRecord &b) const
+        {
+            if (!ByRowID)
+                return less(a, b);
+            if (less(a, b))
+                return true;
+            if (less(b, a))
+                return false;
+            return rowid_key(a.rowid) < rowid_key(b.rowid);
+        }
+    };
+
+    template <size_t TailSize, bool ByRowID>
+    void top_k_impl(
+        const KeyView &keys,
+        std::vector<RowID> &rowids,
+        size_t offset,
+        size_t window_end,
+        const ExecutionContext &ctx)
+    {
+        const size_t n = rowids.size();
+        const size_t key_size = keys.key_size();
+        const WindowLess<TailSize, ByRowID> less(keys);
+        const size_t parts = std::max<size_t>(1, std::min(ctx.num_threads(), n / window_end));
+
+        // 1) One bounded max-heap per part. Once a heap is full, no key with a larger prefix than its top can be
+        //    in the window, so the smallest such prefix over all heaps is shared as the rejection threshold.
+        std::atomic<uint64_t> threshold{UINT64_MAX};
+        std::vector<std::vector<PrefixRecord>> heaps(parts);
+        parallel_for(ctx, parts, [&](size_t p)
+                     {
+            std::vector<PrefixRecord> &heap = heaps[p];
+            heap.reserve(window_end);
+            uint64_t published = UINT64_MAX;
+            auto publish = [&]
+            {
+                const uint64_t bound = heap.front().prefix;
+                if (bound >= published)
+                    return;
+                published = bound;
+                uint64_t current = threshold.load(std::memory_order_relaxed);
+                while (bound < current && !threshold.compare_exchange_weak(current, bound, std::memory_order_relaxed))
+                    ;
+            };
+
+            const size_t end = (p + 1) * n / parts;
+            for (size_t i = p * n / parts; i < end; ++i)
+            {
+                const uint64_t prefix = load_key_prefix(keys[row_index(rowids[i])], key_size);
+                if (prefix > threshold.load(std::memory_order_relaxed))
+                    continue;
+                const PrefixRecord record{prefix, rowids[i]};
+                if (heap.size() < window_end)
+                {
+                    heap.push_back(record);
+                    std::push_heap(heap.begin(), heap.end(), less);
+                    if (heap.size() == window_end)
+                        publish();
+                    continue;
+                }
+                if (!less(record, heap.front()))
+                    continue;
+                std::pop_heap(heap.begin(), heap.end(), less);
+                heap.back() = record;
+                std::push_heap(heap.begin(), heap.end(), less);
+                publish();
+            } });
+
+        // 2) The window is among the candidates of all heaps; select it and sort only that. A key is only rejected
+        //    while some heap is full, so there are always at least window_end candidates.
+        std::vector<PrefixRecord> candidates;
+        for (auto &heap : heaps)
+        {
+            candidates.insert(candidates.end(), heap.begin(), heap.end());
+            std::vector<PrefixRecord>().swap(heap);
+        }
+        std::nth_element(candidates.begin(), candidates.begin() + window_end, candidates.end(), less);
+        candidates.resize(window_end);
+        pdqsort(candidates.begin(), candidates.end(), less);
+
+        rowids.resize(window_end - offset);
+        for (size_t i = 0; i < rowids.size(); ++i)
+            rowids[i] = candidates[offset + i].rowid;
+    }
+}
+
+void top_k_rowids(
+    const KeyView &keys,
+    std::vector<RowID> &rowids,
+    size_t offset,
+    size_t limit,
+    const ExecutionContext &ctx,
+    TieBreak tie_break)
+{
+    const size_t n = rowids.size();
+    if (offset >= n || limit == 0)
+    {
+        rowids.clear();
+        return;
+    }
+    const size_t window_end = offset + std::min(limit, n - offset);
+
+    if (window_end > n / FULL_SORT_DIVISOR)
+    {
+        hybrid_radix_sort_rowids_msb(keys, rowids, ctx, MSD_RADIX_CUTOFF, tie_break);
+        rowids.erase(rowids.begin(), rowids.begin() + offset);
+        rowids.resize(window_end - offset);
+        return;
+    }
+
+    dispatch_key_size(prefix_tail_size(keys.key_size()), [&](auto tail)
+                      {
+        constexpr size_t tail_size = decltype(tail)::value;
+        if (tie_break == TieBreak::RowID)
+            top_k_impl<tail_size, true>(keys, rowids, offset, window_end, ctx);
+        else
+            top_k_impl<tail_size, false>(keys, rowids, offset, window_end, ctx); });
+}
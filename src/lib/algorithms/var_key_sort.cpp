@@ -0,0 +1,153 @@
+#include "algorithms/var_key_sort.hpp"
+
+#include <array>
+#include <algorithm>
+#include <pdqsort.h>
+
+#include "common.hpp"
+#include "algorithms/msd_leaves.hpp"
+#include "utils/perf_counters.hpp"
+
+namespace
+{
+    // Bucket 0 holds the keys that end before the current byte, bucket b + 1 the keys whose byte is b
+    constexpr size_t VAR_RADIX = RADIX + 1;
+
+    using VarCounts = std::array<size_t, VAR_RADIX>;
+
+    // Buckets at least this large are sorted as separate tasks
+    constexpr size_t VAR_SPAWN_THRESHOLD = 1 << 14;
+
+    inline uint16_t digit_of(const VarKeyView &keys, const RowID &rid, size_t byte_index)
+    {
+        const VarKey &key = keys[row_index(rid)];
+        return byte_index < key.length ? uint16_t(keys.byte(key, byte_index) + 1) : 0;
+    }
+
+    struct VarMsdContext
+    {
+        const VarKeyView &keys;
+        size_t cutoff;
+        TaskGroup *group;
+    };
+
+    // digits is scratch space for n digits; each child bucket reuses its own slice once the parent has scattered
+    void var_msd_recurse(
+        const VarMsdContext &ctx,
+        RowID *rowids,
+        RowID *scratch,
+        uint16_t *digits,
+        size_t n,
+        size_t byte_index)
+    {
+        const VarKeyView &keys = ctx.keys;
+        VarCounts count;
+
+        for (;;)
+        {
+            if (n <= 1)
+                return;
+
+            if (n < ctx.cutoff)
+            {
+                const VarKeyLess less(keys);
+                pdqsort(rowids, rowids + n,
+                        [&](const RowID &a, const RowID &b)
+                        { return less(keys[row_index(a)], keys[row_index(b)]); });
+                return;
+            }
+
+            count = {};
+            for (size_t i = 0; i < n; ++i)
+            {
+                const uint16_t d = digit_of(keys, rowids[i], byte_index);
+                digits[i] = d;
+                count[d]++;
+            }
+
+            if (count[digits[0]] != n)
+                break;
+            // Every key ended: they are all equal
+            if (digits[0] == 0)
+                return;
+            // Byte is constant within this bucket: move on to the next one without scattering
+            ++byte_index;
+        }
+
+        VarCounts fill;
+        size_t sum = 0;
+        for (size_t b = 0; b < VAR_RADIX; ++b)
+        {
+            fill[b] = sum;
+            sum += count[b];
+        }
+        scatter_by_digits<sizeof(RowID), VAR_RADIX>(
+            reinterpret_cast<const uint8_t *>(rowids), reinterpret_cast<uint8_t *>(scratch), digits, 0, n, sizeof(RowID), fill);
+        std::copy(scratch, scratch + n, rowids);
+
+        // Bucket 0 is already in its final place
+        size_t bucket_begin = count[0];
+        for (size_t b = 1; b < VAR_RADIX; ++b)
+        {
+            const size_t bucket_size = count[b];
+            if (bucket_size > 1)
+            {
+                RowID *child = rowids + bucket_begin;
+                RowID *child_scratch = scratch + bucket_begin;
+                uint16_t *child_digits = digits + bucket_begin;
+                const size_t child_byte = byte_index + 1;
+                if (ctx.group != nullptr && bucket_size >= VAR_SPAWN_THRESHOLD)
+                    ctx.group->spawn([&ctx, child, child_scratch, child_digits, bucket_size, child_byte]
+                                     { var_msd_recurse(ctx, child, child_scratch, child_digits, bucket_size, child_byte); });
+                else
+                    var_msd_recurse(ctx, child, child_scratch, child_digits, bucket_size, child_byte);
+            }
+            bucket_begin += bucket_size;
+        }
+    }
+}
+
+void var_key_sort_rowids(
+    const VarKeyView &keys,
+    std::vector<RowID> &rowids,
+    const ExecutionContext &ctx,
+    size_t cutoff,
+    TieBreak tie_break)
+{
+    if (rowids.empty())
+        return;
+    const size_t n = rowids.size();
+    const size_t num_threads = ctx.num_threads();
+
+    // 1) Partition with all threads until every bucket is at most one thread's share of the input, so that a long
+    //    shared prefix such as "https://www." does not end up as one serial task
+    std::vector<RowID> partitioned(n);
+    RowID *const buffers[2] = {rowids.data(), partitioned.data()};
+    const size_t max_leaf = std::max(VAR_SPAWN_THRESHOLD, n / num_threads);
+    std::vector<LeafBucket> leaves;
+    split_oversized<VAR_RADIX, true>(ctx, buffers, 0, n, 0, 0, max_leaf, SIZE_MAX,
+                                     [&](const RowID &rid, size_t byte_index)
+                                     { return digit_of(keys, rid, byte_index); },
+                                     leaves);
+    const int target = result_buffer(leaves, n);
+
+    // 2) Sort the leaves largest-first, spawning large sub-buckets into the runners' group. Keys that ended are
+    //    equal and sorted; their leaves only move to the result buffer if needed.
+    std::vector<uint16_t> digits(n);
+    TaskGroup runners(ctx);
+    const VarMsdContext msd{keys, cutoff, &runners};
+    sort_leaves(ctx, runners, buffers, leaves, [&](const LeafBucket &leaf, RowID *data, RowID *other)
+                {
+        if (leaf.depth != LEAF_SORTED)
+        {
+            const PerfPhase phase("leaf sort");
+            var_msd_recurse(msd, data, other, digits.data() + leaf.begin, leaf.size, leaf.depth);
+        } });
+    gather_leaves(ctx, buffers, leaves, target);
+
+    // 3) Hand back the buffer holding the sorted RowIDs
+    if (target == 1)
+        rowids.swap(partitioned);
+    if (tie_break == TieBreak::RowID)
+        order_ties_by_rowid(keys, rowids, ctx);
+}
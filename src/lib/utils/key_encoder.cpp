@@ -0,0 +1,224 @@
+#include "key_encoder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    // Rows encoded per task
+    constexpr size_t ENCODE_BATCH = 1 << 16;
+
+    size_t value_width(const SortColumn &column)
+    {
+        switch (column.type)
+        {
+        case ColumnType::Int32:
+        case ColumnType::UInt32:
+        case ColumnType::Float32:
+            return 4;
+        case ColumnType::Int64:
+        case ColumnType::UInt64:
+        case ColumnType::Float64:
+            return 8;
+        case ColumnType::String:
+            return column.string_width;
+        }
+        return 0;
+    }
+
+    // Unsigned integers whose order matches the order of the values
+    uint32_t order_preserving(uint32_t value) { return value; }
+    uint64_t order_preserving(uint64_t value) { return value; }
+    uint32_t order_preserving(int32_t value) { return static_cast<uint32_t>(value) ^ (uint32_t{1} << 31); }
+    uint64_t order_preserving(int64_t value) { return static_cast<uint64_t>(value) ^ (uint64_t{1} << 63); }
+
+    template <class Bits, class Float>
+    Bits float_bits(Float value)
+    {
+        // One encoding for both zeros and one for all NaNs; the positive quiet NaN sorts after infinity
+        if (value == 0)
+            value = 0;
+        if (std::isnan(value))
+            value = std::numeric_limits<Float>::quiet_NaN();
+        Bits bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        // Negative values have all bits flipped so that larger magnitudes come first, positive ones the sign bit
+        const Bits sign = Bits{1} << (8 * sizeof(Bits) - 1);
+        const Bits mask = static_cast<Bits>(0 - (bits >> (8 * sizeof(Bits) - 1))) | sign;
+        return bits ^ mask;
+    }
+
+    uint32_t order_preserving(float value) { return float_bits<uint32_t>(value); }
+    uint64_t order_preserving(double value) { return float_bits<uint64_t>(value); }
+
+    void store_big_endian(uint8_t *out, uint32_t value)
+    {
+        value = __builtin_bswap32(value);
+        std::memcpy(out, &value, sizeof(value));
+    }
+
+    void store_big_endian(uint8_t *out, uint64_t value)
+    {
+        value = __builtin_bswap64(value);
+        std::memcpy(out, &value, sizeof(value));
+    }
+
+    // The encoders handle rows [begin, end); out points at the column's bytes in the key of row begin
+    template <class T>
+    void encode_numbers(const SortColumn &column, size_t begin, size_t end, uint8_t *out, size_t key_size)
+    {
+        using Bits = decltype(order_preserving(T{}));
+        const T *values = static_cast<const T *>(column.data);
+        const Bits invert = column.order == SortOrder::Descending ? ~Bits{0} : Bits{0};
+        for (size_t i = begin; i < end; ++i, out += key_size)
+            store_big_endian(out, order_preserving(values[i]) ^ invert);
+    }
+
+    // Copies length bytes with every bit flipped, a word at a time
+    void copy_inverted(uint8_t *out, const char *in, size_t length)
+    {
+        size_t j = 0;
+        for (; j + sizeof(uint64_t) <= length; j += sizeof(uint64_t))
+        {
+            uint64_t word;
+            std::memcpy(&word, in + j, sizeof(word));
+            word = ~word;
+            std::memcpy(out + j, &word, sizeof(word));
+        }
+        for (; j < length; ++j)
+            out[j] = static_cast<uint8_t>(~in[j]);
+    }
+
+    void encode_strings(const SortColumn &column, size_t prefix, size_t begin, size_t end, uint8_t *out, size_t key_size)
+    {
+        const std::string_view *values = static_cast<const std::string_view *>(column.data);
+        const size_t width = column.string_width;
+        const bool invert = column.order == SortOrder::Descending;
+        for (size_t i = begin; i < end; ++i, out += key_size)
+        {
+            // NULL slots may hold any string_view; encode_nulls fills their bytes
+            if (column.validity != nullptr && column.validity[i] == 0)
+                continue;
+            const std::string_view value = values[i];
+            const size_t length = value.size() > prefix ? std::min(value.size() - prefix, width) : 0;
+            // Descending strings are inverted while they are copied, padding included, instead of in a second pass
+            if (invert)
+                copy_inverted(out, value.data() + prefix, length);
+            else if (length > 0)
+                std::memcpy(out, value.data() + prefix, length);
+            std::memset(out + length, invert ? 0xFF : 0x00, width - length);
+        }
+    }
+
+    // Overwrites NULL rows with zero value bytes and writes every row's NULL byte in front of the value
+    void encode_nulls(const SortColumn &column, size_t width, size_t begin, size_t end, uint8_t *out, size_t key_size)
+    {
+        const uint8_t null_byte = column.nulls == NullOrder::NullsFirst ? 0 : 1;
+        for (size_t i = begin; i < end; ++i, out += key_size)
+        {
+            const bool valid = column.validity[i] != 0;
+            out[0] = valid ? 1 - null_byte : null_byte;
+            if (!valid)
+                std::memset(out + 1, 0, width);
+        }
+    }
+
+    // Longest prefix shared by all non-NULL strings of the column
+    size_t common_prefix(const SortColumn &column, size_t num_rows, const ExecutionContext &ctx)
+    {
+        const std::string_view *values = static_cast<const std::string_view *>(column.data);
+        size_t first = 0;
+        while (first < num_rows && column.validity != nullptr && column.validity[first] == 0)
+            ++first;
+        if (first == num_rows)
+            return 0;
+        const std::string_view reference = values[first];
+
+        const size_t num_batches = (num_rows + ENCODE_BATCH - 1) / ENCODE_BATCH;
+        std::vector<size_t> batch_prefix(num_batches);
+        parallel_for(ctx, num_batches, [&](size_t b)
+                     {
+            size_t prefix = reference.size();
+            const size_t end = std::min(num_rows, (b + 1) * ENCODE_BATCH);
+            for (size_t i = b * ENCODE_BATCH; i < end && prefix > 0; ++i)
+            {
+                if (column.validity != nullptr && column.validity[i] == 0)
+                    continue;
+                const std::string_view value = values[i];
+                const size_t limit = std::min(prefix, value.size());
+                prefix = std::mismatch(reference.begin(), reference.begin() + limit, value.begin()).first - reference.begin();
+            }
+            batch_prefix[b] = prefix; });
+        return *std::min_element(batch_prefix.begin(), batch_prefix.end());
+    }
+}
+
+size_t encoded_key_size(const std::vector<SortColumn> &columns)
+{
+    size_t key_size = 0;
+    for (const auto &column : columns)
+        key_size += (column.validity != nullptr ? 1 : 0) + value_width(column);
+    return key_size;
+}
+
+void encode_keys(
+    const std::vector<SortColumn> &columns,
+    size_t num_rows,
+    KeyArena &keys,
+    const ExecutionContext &ctx)
+{
+    const size_t key_size = encoded_key_size(columns);
+    keys.resize(num_rows, key_size);
+    if (num_rows == 0 || key_size == 0)
+        return;
+
+    std::vector<size_t> prefixes(columns.size(), 0);
+    for (size_t c = 0; c < columns.size(); ++c)
+    {
+        if (columns[c].type == ColumnType::String)
+            prefixes[c] = common_prefix(columns[c], num_rows, ctx);
+    }
+
+    const size_t num_batches = (num_rows + ENCODE_BATCH - 1) / ENCODE_BATCH;
+    parallel_for(ctx, num_batches, [&](size_t b)
+                 {
+        const size_t begin = b * ENCODE_BATCH;
+        const size_t end = std::min(num_rows, begin + ENCODE_BATCH);
+        uint8_t *batch_keys = keys[begin];
+        size_t offset = 0;
+        for (size_t c = 0; c < columns.size(); ++c)
+        {
+            const SortColumn &column = columns[c];
+            const bool nullable = column.validity != nullptr;
+            uint8_t *out = batch_keys + offset + (nullable ? 1 : 0);
+            switch (column.type)
+            {
+            case ColumnType::Int32:
+                encode_numbers<int32_t>(column, begin, end, out, key_size);
+                break;
+            case ColumnType::Int64:
+                encode_numbers<int64_t>(column, begin, end, out, key_size);
+                break;
+            case ColumnType::UInt32:
+                encode_numbers<uint32_t>(column, begin, end, out, key_size);
+                break;
+            case ColumnType::UInt64:
+                encode_numbers<uint64_t>(column, begin, end, out, key_size);
+                break;
+            case ColumnType::Float32:
+                encode_numbers<float>(column, begin, end, out, key_size);
+                break;
+            case ColumnType::Float64:
+                encode_numbers<double>(column, begin, end, out, key_size);
+                break;
+            case ColumnType::String:
+                encode_strings(column, prefixes[c], begin, end, out, key_size);
+                break;
+            }
+            if (nullable)
+                encode_nulls(column, value_width(column), begin, end, batch_keys + offset, key_size);
+            offset += (nullable ? 1 : 0) + value_width(column);
+        } });
+}
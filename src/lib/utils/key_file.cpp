@@ -0,0 +1,106 @@
+#include "key_file.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    [[noreturn]] void throw_errno(const std::string &what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    // Closes the descriptor when the scope is left; the mapping stays valid without it
+    struct FileDescriptor
+    {
+        int fd;
+        ~FileDescriptor()
+        {
+            if (fd >= 0)
+                close(fd);
+        }
+    };
+}
+
+MappedKeyFile::MappedKeyFile(const std::string &path, KeyFileLoad load)
+{
+    const FileDescriptor file{open(path.c_str(), O_RDONLY)};
+    if (file.fd < 0)
+        throw_errno("cannot open key file " + path);
+    struct stat st;
+    if (fstat(file.fd, &st) != 0)
+        throw_errno("cannot stat key file " + path);
+    const size_t file_size = static_cast<size_t>(st.st_size);
+    if (file_size < sizeof(KeyFileHeader))
+        throw std::runtime_error(path + " is too small to be a key file");
+
+    const int flags = MAP_PRIVATE | (load == KeyFileLoad::Prefault ? MAP_POPULATE : 0);
+    void *mapping = mmap(nullptr, file_size, PROT_READ, flags, file.fd, 0);
+    if (mapping == MAP_FAILED)
+        throw_errno("cannot map key file " + path);
+    _mapping = mapping;
+    _mapping_size = file_size;
+
+    KeyFileHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    const size_t data_size = file_size - sizeof(KeyFileHeader);
+    if (std::memcmp(header.magic, KEY_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != KEY_FILE_VERSION ||
+        header.key_size == 0 || header.num_keys > data_size / header.key_size ||
+        header.num_keys * header.key_size != data_size)
+    {
+        munmap(_mapping, _mapping_size);
+        throw std::runtime_error(path + " is not a valid key file");
+    }
+
+    _keys = static_cast<const uint8_t *>(mapping) + sizeof(KeyFileHeader);
+    _num_keys = header.num_keys;
+    _key_size = header.key_size;
+    _chunk_size = header.chunk_size;
+    if (load == KeyFileLoad::WillNeed)
+        madvise(_mapping, _mapping_size, MADV_WILLNEED);
+}
+
+MappedKeyFile::~MappedKeyFile()
+{
+    if (_mapping != nullptr)
+        munmap(_mapping, _mapping_size);
+}
+
+void write_key_file(const std::string &path, const KeyView &keys, size_t chunk_size)
+{
+    const FileDescriptor file{open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)};
+    if (file.fd < 0)
+        throw_errno("cannot create key file " + path);
+
+    KeyFileHeader header{};
+    std::memcpy(header.magic, KEY_FILE_MAGIC, sizeof(header.magic));
+    header.version = KEY_FILE_VERSION;
+    header.key_size = static_cast<uint32_t>(keys.key_size());
+    header.num_keys = keys.size();
+    header.chunk_size = chunk_size;
+
+    auto write_all = [&](const void *data, size_t bytes)
+    {
+        const char *p = static_cast<const char *>(data);
+        while (bytes > 0)
+        {
+            const ssize_t written = write(file.fd, p, bytes);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw_errno("cannot write key file " + path);
+            }
+            p += written;
+            bytes -= static_cast<size_t>(written);
+        }
+    };
+    write_all(&header, sizeof(header));
+    write_all(keys.data(), keys.size() * keys.key_size());
+}
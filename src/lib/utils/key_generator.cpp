@@ -0,0 +1,245 @@
+#include "key_generator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Keys generated per task
+    constexpr size_t GENERATE_BATCH = 1 << 16;
+
+    constexpr uint64_t GOLDEN = 0x9e3779b97f4a7c15ull;
+
+    // Streams for the values that do not belong to one key
+    constexpr uint64_t DISTINCT_STREAM = 1;
+    constexpr uint64_t PREFIX_STREAM = 2;
+    constexpr uint64_t SWAP_STREAM = 3;
+
+    // splitmix64 finalizer
+    uint64_t mix64(uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    // Uniform double in [0, 1)
+    double random_unit(uint64_t seed, uint64_t index, uint64_t counter)
+    {
+        return (random_word(seed, index, counter) >> 11) * 0x1p-53;
+    }
+
+    // Fills bytes [begin, end) of a key with random words of the given index
+    void fill_random(uint8_t *key, size_t begin, size_t end, uint64_t seed, uint64_t index)
+    {
+        for (size_t i = begin, counter = 0; i < end; i += 8, ++counter)
+        {
+            const uint64_t word = random_word(seed, index, counter);
+            std::memcpy(key + i, &word, std::min<size_t>(8, end - i));
+        }
+    }
+
+    // Key of the given rank in an ascending sequence of num_keys keys: the rank spread evenly over the first (up
+    // to) 8 bytes as a big-endian integer, followed by random bytes
+    void write_sorted_key(uint8_t *key, size_t key_size, size_t rank, size_t num_keys, uint64_t seed)
+    {
+        const size_t width = std::min<size_t>(8, key_size);
+        const uint64_t value = static_cast<uint64_t>(((unsigned __int128)rank << (8 * width)) / num_keys);
+        for (size_t i = 0; i < width; ++i)
+            key[i] = static_cast<uint8_t>(value >> (8 * (width - 1 - i)));
+        fill_random(key, width, key_size, seed, rank);
+    }
+
+    // Zipf ranks by rejection-inversion (Hoermann and Derflinger, 1996): constant expected time per sample and no
+    // table, so large cardinalities cost nothing to set up
+    class ZipfSampler
+    {
+    public:
+        ZipfSampler(size_t cardinality, double exponent)
+            : _cardinality(cardinality), _exponent(exponent)
+        {
+            _h_integral_x1 = h_integral(1.5) - 1;
+            _h_integral_n = h_integral(cardinality + 0.5);
+            _s = 2 - h_integral_inverse(h_integral(2.5) - h(2));
+        }
+
+        // Rank in [0, cardinality) for the key with the given index; rank 0 is the most frequent
+        size_t operator()(uint64_t seed, uint64_t index) const
+        {
+            for (uint64_t counter = 0;; ++counter)
+            {
+                const double u = _h_integral_n + random_unit(seed, index, counter) * (_h_integral_x1 - _h_integral_n);
+                const double x = h_integral_inverse(u);
+                const double k = std::clamp(std::floor(x + 0.5), 1.0, double(_cardinality));
+                if (k - x <= _s || u >= h_integral(k + 0.5) - h(k))
+                    return static_cast<size_t>(k) - 1;
+            }
+        }
+
+    private:
+        // log1p(x) / x and expm1(x) / x, by their series near 0
+        static double log1p_ratio(double x)
+        {
+            return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+        }
+
+        static double expm1_ratio(double x)
+        {
+            return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+        }
+
+        double h(double x) const { return std::exp(-_exponent * std::log(x)); }
+
+        double h_integral(double x) const
+        {
+            const double log_x = std::log(x);
+            return expm1_ratio((1 - _exponent) * log_x) * log_x;
+        }
+
+        double h_integral_inverse(double x) const
+        {
+            const double t = std::max(-1.0, x * (1 - _exponent));
+            return std::exp(log1p_ratio(t) * x);
+        }
+
+        size_t _cardinality;
+        double _exponent;
+        double _h_integral_x1;
+        double _h_integral_n;
+        double _s;
+    };
+}
+
+uint64_t random_word(uint64_t seed, uint64_t index, uint64_t counter)
+{
+    return mix64(mix64(seed ^ (index * GOLDEN)) + counter * GOLDEN);
+}
+
+const char *key_distribution_name(KeyDistribution distribution)
+{
+    switch (distribution)
+    {
+    case KeyDistribution::Uniform:
+        return "uniform";
+    case KeyDistribution::Zipf:
+        return "zipf";
+    case KeyDistribution::FewUnique:
+        return "few_unique";
+    case KeyDistribution::Sorted:
+        return "sorted";
+    case KeyDistribution::Reverse:
+        return "reverse";
+    case KeyDistribution::NearlySorted:
+        return "nearly_sorted";
+    case KeyDistribution::SharedPrefix:
+        return "shared_prefix";
+    case KeyDistribution::OrganPipe:
+        return "organ_pipe";
+    }
+    return "unknown";
+}
+
+KeyDistribution parse_key_distribution(std::string_view name)
+{
+    for (KeyDistribution distribution :
+         {KeyDistribution::Uniform, KeyDistribution::Zipf, KeyDistribution::FewUnique, KeyDistribution::Sorted,
+          KeyDistribution::Reverse, KeyDistribution::NearlySorted, KeyDistribution::SharedPrefix,
+          KeyDistribution::OrganPipe})
+    {
+        if (name == key_distribution_name(distribution))
+            return distribution;
+    }
+    throw std::invalid_argument("unknown key distribution: " + std::string(name));
+}
+
+void generate_keys(
+    KeyArena &keys,
+    size_t num_keys,
+    size_t key_size,
+    const KeyGeneratorOptions &options,
+    const ExecutionContext &ctx)
+{
+    keys.resize(num_keys, key_size);
+    if (num_keys == 0 || key_size == 0)
+        return;
+    const uint64_t seed = options.seed;
+    const KeyDistribution distribution = options.distribution;
+
+    // Zipf and FewUnique copy from a table of distinct keys
+    KeyArena distinct;
+    const size_t cardinality = std::max<size_t>(1, options.cardinality);
+    if (distribution == KeyDistribution::Zipf || distribution == KeyDistribution::FewUnique)
+    {
+        distinct.resize(cardinality, key_size);
+        parallel_for(ctx, (cardinality + GENERATE_BATCH - 1) / GENERATE_BATCH, [&](size_t batch)
+                     {
+            const size_t end = std::min(cardinality, (batch + 1) * GENERATE_BATCH);
+            for (size_t r = batch * GENERATE_BATCH; r < end; ++r)
+                fill_random(distinct[r], 0, key_size, seed + DISTINCT_STREAM, r); });
+    }
+    const ZipfSampler zipf(cardinality, std::max(options.zipf_exponent, 1e-6));
+
+    const size_t prefix_length = options.prefix_length > 0 ? std::min(options.prefix_length, key_size)
+                                                           : key_size - std::min<size_t>(4, key_size);
+    std::vector<uint8_t> prefix(prefix_length);
+    fill_random(prefix.data(), 0, prefix_length, seed + PREFIX_STREAM, 0);
+
+    const size_t num_batches = (num_keys + GENERATE_BATCH - 1) / GENERATE_BATCH;
+    parallel_for(ctx, num_batches, [&](size_t batch)
+                 {
+        const size_t end = std::min(num_keys, (batch + 1) * GENERATE_BATCH);
+        for (size_t i = batch * GENERATE_BATCH; i < end; ++i)
+        {
+            uint8_t *key = keys[i];
+            switch (distribution)
+            {
+            case KeyDistribution::Uniform:
+                fill_random(key, 0, key_size, seed, i);
+                break;
+            case KeyDistribution::Zipf:
+                std::memcpy(key, distinct[zipf(seed, i)], key_size);
+                break;
+            case KeyDistribution::FewUnique:
+                std::memcpy(key, distinct[random_word(seed, i, 0) % cardinality], key_size);
+                break;
+            case KeyDistribution::Sorted:
+            case KeyDistribution::NearlySorted:
+                write_sorted_key(key, key_size, i, num_keys, seed);
+                break;
+            case KeyDistribution::Reverse:
+                write_sorted_key(key, key_size, num_keys - 1 - i, num_keys, seed);
+                break;
+            case KeyDistribution::SharedPrefix:
+                std::memcpy(key, prefix.data(), prefix_length);
+                fill_random(key, prefix_length, key_size, seed, i);
+                break;
+            case KeyDistribution::OrganPipe:
+            {
+                // Even ranks rise through the first half, odd ranks fall through the second
+                const size_t half = (num_keys + 1) / 2;
+                const size_t rank = i < half ? 2 * i : 2 * (num_keys - 1 - i) + 1;
+                write_sorted_key(key, key_size, rank, num_keys, seed);
+                break;
+            }
+            }
+        } });
+
+    // The swaps may overlap, so they are applied in order
+    if (distribution == KeyDistribution::NearlySorted)
+    {
+        const size_t num_swaps = static_cast<size_t>(num_keys * std::clamp(options.swap_percent, 0.0, 100.0) / 100);
+        std::vector<uint8_t> temp(key_size);
+        for (size_t s = 0; s < num_swaps; ++s)
+        {
+            const size_t a = random_word(seed + SWAP_STREAM, s, 0) % num_keys;
+            const size_t b = random_word(seed + SWAP_STREAM, s, 1) % num_keys;
+            std::memcpy(temp.data(), keys[a], key_size);
+            std::memcpy(keys[a], keys[b], key_size);
+            std::memcpy(keys[b], temp.data(), key_size);
+        }
+    }
+}
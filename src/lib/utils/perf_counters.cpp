@@ -0,0 +1,294 @@
+#include "utils/perf_counters.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+    struct EventConfig
+    {
+        uint32_t type;
+        uint64_t config;
+    };
+
+    constexpr uint64_t cache_miss(uint64_t cache)
+    {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    // In PerfEvent order; cycles lead the group
+    const std::array<EventConfig, NUM_PERF_EVENTS> EVENT_CONFIGS = {{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_DTLB)},
+    }};
+
+    // The counter group of one thread, opened on the first phase it enters
+    class ThreadCounters
+    {
+    public:
+        ~ThreadCounters()
+        {
+            for (int fd : _fds)
+            {
+                if (fd >= 0)
+                    close(fd);
+            }
+        }
+
+        // Current counts and the time the group was enabled and running; events that are not available stay 0
+        void read(std::array<uint64_t, NUM_PERF_EVENTS> &events, uint64_t &time_enabled, uint64_t &time_running)
+        {
+            events = {};
+            time_enabled = time_running = 0;
+            if (!_opened)
+                open();
+            if (_leader < 0)
+                return;
+            // The number of counters, the enabled and running times, then the values in the order they were opened
+            uint64_t buffer[3 + NUM_PERF_EVENTS];
+            if (::read(_leader, buffer, sizeof(buffer)) <= 0)
+                return;
+            time_enabled = buffer[1];
+            time_running = buffer[2];
+            for (size_t i = 0; i < buffer[0] && i < _members.size(); ++i)
+                events[_members[i]] = buffer[3 + i];
+        }
+
+        // Depth of nested phases on this thread
+        size_t depth = 0;
+
+    private:
+        void open()
+        {
+            _opened = true;
+            _fds.fill(-1);
+            uint32_t mask = 0;
+            std::string error;
+            for (size_t e = 0; e < NUM_PERF_EVENTS; ++e)
+            {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = EVENT_CONFIGS[e].type;
+                attr.config = EVENT_CONFIGS[e].config;
+                // When the PMU has fewer counters than the group needs, the kernel time-slices it; the enabled and
+                // running times tell how much of a phase the counts cover
+                attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                // Counting user space only works with the default perf_event_paranoid of 2
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                const int fd = static_cast<int>(
+                    syscall(SYS_perf_event_open, &attr, 0, -1, _leader, PERF_FLAG_FD_CLOEXEC));
+                if (fd < 0)
+                {
+                    if (error.empty())
+                        error = std::string(perf_event_name(static_cast<PerfEvent>(e))) + ": " + std::strerror(errno);
+                    continue;
+                }
+                _fds[e] = fd;
+                if (_leader < 0)
+                    _leader = fd;
+                _members.push_back(e);
+                mask |= 1u << e;
+            }
+            PerfProfiler::global().note_counters(mask, error);
+        }
+
+        bool _opened = false;
+        int _leader = -1;
+        std::array<int, NUM_PERF_EVENTS> _fds;
+        std::vector<size_t> _members;
+    };
+
+    ThreadCounters &thread_counters()
+    {
+        thread_local ThreadCounters counters;
+        return counters;
+    }
+}
+
+const char *perf_event_name(PerfEvent event)
+{
+    switch (event)
+    {
+    case PerfEvent::Cycles:
+        return "cycles";
+    case PerfEvent::Instructions:
+        return "instructions";
+    case PerfEvent::LLCMisses:
+        return "llc_misses";
+    case PerfEvent::BranchMisses:
+        return "branch_misses";
+    case PerfEvent::DTLBMisses:
+        return "dtlb_misses";
+    }
+    return "unknown";
+}
+
+PerfProfiler::PerfProfiler()
+{
+    const char *value = std::getenv("SORT_PERF");
+    _enabled = value != nullptr && std::strtoull(value, nullptr, 10) != 0;
+}
+
+PerfProfiler &PerfProfiler::global()
+{
+    static PerfProfiler profiler;
+    return profiler;
+}
+
+bool PerfProfiler::event_available(PerfEvent event)
+{
+    bool probed;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        probed = _probed;
+    }
+    if (!probed)
+    {
+        std::array<uint64_t, NUM_PERF_EVENTS> events;
+        uint64_t time_enabled, time_running;
+        thread_counters().read(events, time_enabled, time_running);
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    return (_available_mask >> static_cast<size_t>(event)) & 1;
+}
+
+void PerfProfiler::note_counters(uint32_t available_mask, const std::string &error)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    // A thread that got fewer counters than the others limits which totals are complete
+    _available_mask = _probed ? _available_mask & available_mask : available_mask;
+    if (_error.empty())
+        _error = error;
+    _probed = true;
+}
+
+void PerfProfiler::add(const char *phase, const PhaseCounters &counters)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _phases.begin();
+    while (it != _phases.end() && it->first != phase)
+        ++it;
+    if (it == _phases.end())
+        it = _phases.insert(it, {phase, PhaseCounters{}});
+    PhaseCounters &total = it->second;
+    total.calls += counters.calls;
+    total.time += counters.time;
+    for (size_t e = 0; e < NUM_PERF_EVENTS; ++e)
+        total.events[e] += counters.events[e];
+    total.multiplexed_calls += counters.multiplexed_calls;
+}
+
+std::vector<std::pair<std::string, PhaseCounters>> PerfProfiler::phases() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _phases;
+}
+
+void PerfProfiler::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _phases.clear();
+}
+
+void PerfProfiler::report(std::ostream &out, size_t runs)
+{
+    const bool any_counter = event_available(PerfEvent::Cycles) || event_available(PerfEvent::Instructions) ||
+                             event_available(PerfEvent::LLCMisses) || event_available(PerfEvent::BranchMisses) ||
+                             event_available(PerfEvent::DTLBMisses);
+    std::lock_guard<std::mutex> lock(_mutex);
+    runs = std::max<size_t>(1, runs);
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+
+    out << std::left << std::setw(12) << "  phase" << std::right << std::setw(8) << "calls" << std::setw(11)
+        << "thread ms";
+    for (size_t e = 0; e < NUM_PERF_EVENTS; ++e)
+        out << std::setw(15) << perf_event_name(static_cast<PerfEvent>(e));
+    out << std::setw(7) << "IPC" << "\n";
+
+    out << std::fixed << std::setprecision(2);
+    for (const auto &[name, counters] : _phases)
+    {
+        out << "  " << std::left << std::setw(10) << name << std::right << std::setw(8) << counters.calls / runs
+            << std::setw(11) << counters.time.count() / 1e6 / runs;
+        for (size_t e = 0; e < NUM_PERF_EVENTS; ++e)
+        {
+            if ((_available_mask >> e) & 1)
+                out << std::setw(15) << counters.events[e] / runs;
+            else
+                out << std::setw(15) << "-";
+        }
+        const uint64_t cycles = counters.events[static_cast<size_t>(PerfEvent::Cycles)];
+        const uint64_t instructions = counters.events[static_cast<size_t>(PerfEvent::Instructions)];
+        if (cycles > 0 && ((_available_mask >> static_cast<size_t>(PerfEvent::Instructions)) & 1))
+            out << std::setw(7) << double(instructions) / cycles;
+        else
+            out << std::setw(7) << "-";
+        out << "\n";
+    }
+    for (const auto &[name, counters] : _phases)
+    {
+        if (any_counter && counters.multiplexed_calls > 0)
+            out << "  " << name << ": counters multiplexed in " << counters.multiplexed_calls << " of "
+                << counters.calls << " calls, their counts are scaled estimates\n";
+    }
+    if (!any_counter)
+        out << "  hardware counters unavailable (" << _error << "), timing only\n";
+    else if (!_error.empty())
+        out << "  some counters unavailable (" << _error << ")\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void PerfPhase::begin(const char *name)
+{
+    _name = name;
+    ThreadCounters &counters = thread_counters();
+    _outermost = counters.depth++ == 0;
+    if (!_outermost)
+        return;
+    counters.read(_events, _time_enabled, _time_running);
+    _start = std::chrono::steady_clock::now();
+}
+
+void PerfPhase::end()
+{
+    ThreadCounters &counters = thread_counters();
+    counters.depth--;
+    if (!_outermost)
+        return;
+    const auto end = std::chrono::steady_clock::now();
+    std::array<uint64_t, NUM_PERF_EVENTS> events;
+    uint64_t time_enabled, time_running;
+    counters.read(events, time_enabled, time_running);
+
+    PhaseCounters phase;
+    phase.calls = 1;
+    phase.time = end - _start;
+    // Counts of a group that was only scheduled for part of the phase are extrapolated to all of it; one that was
+    // never scheduled counts nothing
+    const uint64_t enabled = time_enabled - _time_enabled;
+    const uint64_t running = time_running - _time_running;
+    const double scale = running > 0 ? double(enabled) / running : 0.0;
+    if (running < enabled)
+        phase.multiplexed_calls = 1;
+    for (size_t e = 0; e < NUM_PERF_EVENTS; ++e)
+    {
+        const uint64_t delta = events[e] - _events[e];
+        phase.events[e] = running < enabled ? static_cast<uint64_t>(delta * scale) : delta;
+    }
+    PerfProfiler::global().add(_name, phase);
+}
@@ -0,0 +1,305 @@
+#include "task_scheduler.hpp"
+
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+
+#include "common.hpp"
+
+namespace
+{
+    // Identifies the scheduler and deque of the calling worker thread
+    thread_local TaskScheduler *current_scheduler = nullptr;
+    thread_local size_t current_index = 0;
+    thread_local uint32_t steal_seed = 0x9e3779b9u;
+    // Set while a CallerTimer of a thread outside the scheduler is running, so nested ones do not count twice
+    thread_local bool caller_timed = false;
+
+    uint32_t next_victim()
+    {
+        // xorshift32 to spread thieves over the deques
+        steal_seed ^= steal_seed << 13;
+        steal_seed ^= steal_seed >> 17;
+        steal_seed ^= steal_seed << 5;
+        return steal_seed;
+    }
+
+    constexpr size_t INITIAL_QUEUE_CAPACITY = 256;
+    constexpr int SPIN_ROUNDS = 64;
+
+    // Pins the calling thread to the index-th CPU of the process affinity mask
+    void pin_to_cpu(size_t index)
+    {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+            return;
+
+        size_t target = index % CPU_COUNT(&allowed);
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (!CPU_ISSET(cpu, &allowed))
+                continue;
+            if (target-- == 0)
+            {
+                cpu_set_t pinned;
+                CPU_ZERO(&pinned);
+                CPU_SET(cpu, &pinned);
+                pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned);
+                return;
+            }
+        }
+    }
+}
+
+TaskScheduler::TaskScheduler(size_t num_threads, bool pin_threads)
+{
+    num_threads = std::max<size_t>(1, num_threads);
+    _queues.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+        _queues.push_back(std::make_unique<WorkerQueue>());
+        _queues.back()->ring.resize(INITIAL_QUEUE_CAPACITY);
+    }
+    _workers.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i)
+        _workers.emplace_back([this, i, pin_threads]
+                              { worker_loop(i, pin_threads); });
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(_sleep_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for (std::thread &worker : _workers)
+        if (worker.joinable())
+            worker.join();
+}
+
+TaskScheduler &TaskScheduler::global()
+{
+    static TaskScheduler scheduler(
+        getenv("NUM_THREADS", size_t(std::thread::hardware_concurrency())),
+        getenv("PIN_THREADS", size_t(0)) != 0);
+    return scheduler;
+}
+
+const ExecutionContext &ExecutionContext::global()
+{
+    static const ExecutionContext context(TaskScheduler::global(), getenv("MAX_SORT_THREADS", size_t(0)));
+    return context;
+}
+
+std::vector<std::chrono::nanoseconds> TaskScheduler::busy_times() const
+{
+    std::vector<std::chrono::nanoseconds> times;
+    times.reserve(_queues.size());
+    for (const auto &queue : _queues)
+        times.emplace_back(queue->busy_ns.load(std::memory_order_relaxed));
+    times.emplace_back(_caller_busy_ns.load(std::memory_order_relaxed));
+    return times;
+}
+
+void TaskScheduler::reset_busy_times()
+{
+    for (auto &queue : _queues)
+        queue->busy_ns.store(0, std::memory_order_relaxed);
+    _caller_busy_ns.store(0, std::memory_order_relaxed);
+}
+
+TaskScheduler::CallerTimer::CallerTimer(TaskScheduler &scheduler)
+{
+    if (current_scheduler == &scheduler || caller_timed)
+        return;
+    caller_timed = true;
+    _scheduler = &scheduler;
+    _start = std::chrono::steady_clock::now();
+}
+
+TaskScheduler::CallerTimer::~CallerTimer()
+{
+    if (_scheduler == nullptr)
+        return;
+    const auto elapsed = std::chrono::steady_clock::now() - _start;
+    _scheduler->_caller_busy_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                                          std::memory_order_relaxed);
+    caller_timed = false;
+}
+
+void TaskScheduler::submit(const Task &task)
+{
+    WorkerQueue &queue = current_scheduler == this
+                             ? *_queues[current_index]
+                             : *_queues[_next_queue.fetch_add(1, std::memory_order_relaxed) % _queues.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        const size_t capacity = queue.ring.size();
+        if (queue.size.load(std::memory_order_relaxed) == capacity)
+        {
+            std::vector<Task> grown(capacity * 2);
+            for (size_t i = 0; i < queue.size; ++i)
+                grown[i] = queue.ring[(queue.head + i) % capacity];
+            queue.ring.swap(grown);
+            queue.head = 0;
+        }
+        const size_t size = queue.size.load(std::memory_order_relaxed);
+        queue.ring[(queue.head + size) % queue.ring.size()] = task;
+        queue.size.store(size + 1, std::memory_order_relaxed);
+    }
+
+    _queued.fetch_add(1);
+    if (_sleeping.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(_sleep_mutex);
+        _wake.notify_one();
+    }
+}
+
+bool TaskScheduler::try_get_task(Task &task)
+{
+    const size_t num_queues = _queues.size();
+    const bool is_worker = current_scheduler == this;
+
+    // Own deque: newest task first, it is the most likely to still be in cache
+    if (is_worker)
+    {
+        WorkerQueue &own = *_queues[current_index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.size > 0)
+        {
+            const size_t size = own.size.load(std::memory_order_relaxed) - 1;
+            own.size.store(size, std::memory_order_relaxed);
+            task = own.ring[(own.head + size) % own.ring.size()];
+            _queued.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // Steal the oldest task of another deque, which is usually the largest piece of work
+    const size_t start = next_victim() % num_queues;
+    for (size_t k = 0; k < num_queues; ++k)
+    {
+        const size_t victim = (start + k) % num_queues;
+        if (is_worker && victim == current_index)
+            continue;
+        WorkerQueue &queue = *_queues[victim];
+        if (queue.size.load(std::memory_order_relaxed) == 0)
+            continue;
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.size > 0)
+        {
+            task = queue.ring[queue.head];
+            queue.head = (queue.head + 1) % queue.ring.size();
+            queue.size.store(queue.size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+            _queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::execute(Task &task)
+{
+    TaskGroup *group = task.group;
+    try
+    {
+        task.invoke(task.storage);
+    }
+    catch (...)
+    {
+        group->set_exception(std::current_exception());
+    }
+    // The group may be destroyed as soon as this reaches zero
+    group->_pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void TaskScheduler::worker_loop(size_t index, bool pin_thread)
+{
+    if (pin_thread)
+        pin_to_cpu(index);
+    current_scheduler = this;
+    current_index = index;
+    steal_seed ^= static_cast<uint32_t>(index * 0x85ebca6bu + 1);
+
+    std::atomic<uint64_t> &busy_ns = _queues[index]->busy_ns;
+
+    for (;;)
+    {
+        Task task;
+        if (try_get_task(task))
+        {
+            // Tasks run while a nested sync() waits are part of the outer task's time
+            const auto start = std::chrono::steady_clock::now();
+            execute(task);
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            busy_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), std::memory_order_relaxed);
+            continue;
+        }
+
+        bool has_work = false;
+        for (int spin = 0; spin < SPIN_ROUNDS && !has_work; ++spin)
+        {
+            has_work = _queued.load() > 0;
+            if (!has_work)
+                std::this_thread::yield();
+        }
+        if (has_work)
+            continue;
+
+        std::unique_lock<std::mutex> lock(_sleep_mutex);
+        _sleeping.fetch_add(1);
+        _wake.wait(lock, [this]
+                   { return _stop.load() || _queued.load() > 0; });
+        _sleeping.fetch_sub(1);
+        if (_stop.load() && _queued.load() == 0)
+            return;
+    }
+}
+
+TaskGroup::~TaskGroup()
+{
+    // Never leave tasks behind that reference this group; exceptions are dropped here
+    while (_pending.load(std::memory_order_acquire) != 0)
+    {
+        Task task;
+        if (_scheduler.try_get_task(task))
+        {
+            const TaskScheduler::CallerTimer timer(_scheduler);
+            _scheduler.execute(task);
+        }
+        else
+            std::this_thread::yield();
+    }
+}
+
+void TaskGroup::sync()
+{
+    while (_pending.load(std::memory_order_acquire) != 0)
+    {
+        Task task;
+        if (_scheduler.try_get_task(task))
+        {
+            const TaskScheduler::CallerTimer timer(_scheduler);
+            _scheduler.execute(task);
+        }
+        else
+            std::this_thread::yield();
+    }
+
+    if (_exception)
+    {
+        std::exception_ptr exception = std::move(_exception);
+        _exception = nullptr;
+        std::rethrow_exception(exception);
+    }
+}
+
+void TaskGroup::set_exception(std::exception_ptr exception)
+{
+    std::lock_guard<std::mutex> lock(_exception_mutex);
+    if (!_exception)
+        _exception = std::move(exception);
+}